@@ -0,0 +1,294 @@
+/**
+ * File: analyzer.cc
+ * -----------------
+ * Provides the implementation of the Analyzer class.
+ */
+
+#include "analyzer.h"
+#include "components.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+/**
+ * Constants governing the expected-size iteration within a component:
+ * it stops once no value moves by more than kTolerance (relative), and
+ * gives up after kMaxIterations sweeps or once a value passes
+ * kDivergence, declaring the whole component unbounded.
+ */
+
+static const int kMaxIterations = 1000;
+static const double kTolerance = 1e-12;
+static const double kDivergence = 1e18;
+
+/**
+ * Constructor: Analyzer
+ * ---------------------
+ * Runs reachability, undefined-symbol detection, and the size analyses,
+ * once with every terminal costing 1 (lengths) and once with every
+ * terminal costing its text plus a separator (bytes).
+ */
+
+Analyzer::Analyzer(const Grammar& grammar) : grammar(grammar)
+{
+  computeReachable();
+  computeComponents(false, components);
+  computeComponents(true, usableComponents);
+
+  vector<double> lengthCosts(grammar.getNumSymbols(), 1);
+  vector<double> byteCosts(grammar.getNumSymbols(), 1);
+  for (int symbol = grammar.getNumNonterminals(); symbol < grammar.getNumSymbols(); symbol++) {
+    const char *name = grammar.getSymbolName(symbol);
+    int length = grammar.getSymbolLength(symbol);
+    byteCosts[symbol] = length + 1;
+    if (length > 2 && name[0] == '<' && name[length - 1] == '>')
+      undefinedSymbols.push_back(symbol);
+  }
+
+  computeExpected(lengthCosts, expectedLengths);
+  computeExpected(byteCosts, expectedBytes);
+  computeMaximum(lengthCosts, maxLengths);
+  computeMaximum(byteCosts, maxBytes);
+}
+
+/**
+ * Method: computeReachable
+ * ------------------------
+ * Depth-first search over "appears in a production of" from <start>.
+ */
+
+void Analyzer::computeReachable()
+{
+  reachable.assign(grammar.getNumNonterminals(), false);
+  int start = grammar.getStartSymbol();
+  if (!grammar.isNonterminal(start)) return;
+
+  vector<int> pending(1, start);
+  reachable[start] = true;
+  while (!pending.empty()) {
+    int nt = pending.back();
+    pending.pop_back();
+    for (int p = grammar.getFirstProduction(nt); p < grammar.getFirstProduction(nt) + grammar.getNumProductions(nt); p++) {
+      for (const int *curr = grammar.productionBegin(p); curr != grammar.productionEnd(p); ++curr) {
+        if (grammar.isNonterminal(*curr) && !reachable[*curr]) {
+          reachable[*curr] = true;
+          pending.push_back(*curr);
+        }
+      }
+    }
+  }
+}
+
+/**
+ * Method: computeComponents
+ * -------------------------
+ * Splits the graph in which each nonterminal points to the nonterminals
+ * its productions mention into strongly connected components, leaves
+ * first, which is the order the size analyses need.  With usableOnly,
+ * the nonterminals that can't terminate and the productions that can't
+ * finish are left out.
+ */
+
+void Analyzer::computeComponents(bool usableOnly, vector<vector<int> >& result) const
+{
+  vector<vector<int> > successors(grammar.getNumNonterminals());
+  for (int nt = 0; nt < grammar.getNumNonterminals(); nt++) {
+    if (usableOnly && !canTerminate(nt)) continue;
+    for (int p = grammar.getFirstProduction(nt); p < grammar.getFirstProduction(nt) + grammar.getNumProductions(nt); p++) {
+      if (usableOnly && !isUsable(p)) continue;
+      for (const int *curr = grammar.productionBegin(p); curr != grammar.productionEnd(p); ++curr)
+        if (grammar.isNonterminal(*curr)) successors[nt].push_back(*curr);
+    }
+  }
+
+  findComponents(successors, result);
+  if (!usableOnly) return;
+
+  size_t kept = 0;
+  for (size_t c = 0; c < result.size(); c++)
+    if (canTerminate(result[c][0])) result[kept++].swap(result[c]);
+  result.resize(kept);
+}
+
+/**
+ * Method: isUsable
+ * ----------------
+ * Returns true if every symbol of the specified production can
+ * terminate, so that some finished derivation can use it.
+ */
+
+bool Analyzer::isUsable(int production) const
+{
+  for (const int *curr = grammar.productionBegin(production); curr != grammar.productionEnd(production); ++curr)
+    if (grammar.isNonterminal(*curr) && !canTerminate(*curr)) return false;
+  return true;
+}
+
+/**
+ * Method: computeExpected
+ * -----------------------
+ * Solves E[A] = sum over A's productions p of P(p) * sum over p's
+ * symbols X of E[X], where a terminal's E is its cost and P(p) is p's
+ * share of the weights.  Components are solved leaves first, so
+ * everything outside the current one is already final, and within it
+ * Gauss-Seidel iteration up from zero converges to the least solution
+ * when the expansion is expected to finish and grows without settling
+ * when it isn't.  Every member of a component can reach every other
+ * with positive probability, so one unbounded member makes them all
+ * unbounded.  Nonterminals that can't terminate are infinite from the
+ * start, and the infinity flows into everything that may choose them.
+ */
+
+void Analyzer::computeExpected(const vector<double>& costs, vector<double>& expected) const
+{
+  expected.assign(grammar.getNumNonterminals(), 0);
+  for (int nt = 0; nt < grammar.getNumNonterminals(); nt++)
+    if (!canTerminate(nt)) expected[nt] = HUGE_VAL;
+
+  for (size_t c = 0; c < components.size(); c++) {
+    const vector<int>& members = components[c];
+    bool converged = false, diverged = false;
+    for (int iteration = 0; iteration < kMaxIterations && !converged && !diverged; iteration++) {
+      converged = true;
+      for (size_t i = 0; i < members.size(); i++) {
+        int nt = members[i];
+        if (expected[nt] == HUGE_VAL) continue;
+        int first = grammar.getFirstProduction(nt), count = grammar.getNumProductions(nt);
+        double total = 0, value = 0;
+        for (int p = first; p < first + count; p++) total += grammar.getProductionWeight(p);
+        for (int p = first; p < first + count; p++) {
+          double sum = 0;
+          for (const int *curr = grammar.productionBegin(p); curr != grammar.productionEnd(p); ++curr)
+            sum += grammar.isNonterminal(*curr) ? expected[*curr] : costs[*curr];
+          value += grammar.getProductionWeight(p) / total * sum;
+        }
+        if (value != expected[nt] && fabs(value - expected[nt]) > kTolerance * max(1.0, value)) converged = false;
+        if (value != HUGE_VAL && value > kDivergence) diverged = true;
+        expected[nt] = value;
+      }
+    }
+    if (!converged)
+      for (size_t i = 0; i < members.size(); i++) expected[members[i]] = HUGE_VAL;
+  }
+}
+
+/**
+ * Method: computeMaximum
+ * ----------------------
+ * Works through the usable components leaves first.  Within a
+ * component, a production that mentions no member is an exit, worth
+ * the sum of its symbols' (final) sizes.  A production that mentions
+ * a member can be repeated forever, so the component is unbounded if
+ * any such production adds something besides that one member, or
+ * mentions two members while some exit is worth anything.  Otherwise
+ * the members only lead to one another through productions that add
+ * nothing, and each can reach every exit, so all of them are worth
+ * the largest exit.  Nonterminals that can't terminate have no finite
+ * expansion at all and are reported as unbounded.
+ */
+
+void Analyzer::computeMaximum(const vector<double>& costs, vector<double>& maximum) const
+{
+  maximum.assign(grammar.getNumNonterminals(), HUGE_VAL);
+  vector<int> owner(grammar.getNumNonterminals(), -1);
+  for (size_t c = 0; c < usableComponents.size(); c++) {
+    const vector<int>& members = usableComponents[c];
+    for (size_t i = 0; i < members.size(); i++) owner[members[i]] = c;
+
+    double largestExit = 0;
+    bool pumps = false, branches = false;
+    for (size_t i = 0; i < members.size(); i++) {
+      int nt = members[i];
+      for (int p = grammar.getFirstProduction(nt); p < grammar.getFirstProduction(nt) + grammar.getNumProductions(nt); p++) {
+        if (!isUsable(p)) continue;
+        int inside = 0;
+        double rest = 0;
+        for (const int *curr = grammar.productionBegin(p); curr != grammar.productionEnd(p); ++curr) {
+          if (!grammar.isNonterminal(*curr)) rest += costs[*curr];
+          else if (owner[*curr] == (int) c) inside++;
+          else rest += maximum[*curr];
+        }
+        if (inside == 0) largestExit = max(largestExit, rest);
+        else if (rest > 0) pumps = true;
+        else if (inside > 1) branches = true;
+      }
+    }
+
+    double value = (pumps || (branches && largestExit > 0)) ? HUGE_VAL : largestExit;
+    for (size_t i = 0; i < members.size(); i++) maximum[members[i]] = value;
+  }
+}
+
+bool Analyzer::isAcceptable() const
+{
+  int start = grammar.getStartSymbol();
+  if (!grammar.isNonterminal(start)) return true;
+  for (int nt = 0; nt < grammar.getNumNonterminals(); nt++)
+    if (reachable[nt] && !canTerminate(nt)) return false;
+  return expectedLengths[start] != HUGE_VAL;
+}
+
+/**
+ * Function: formatSize
+ * --------------------
+ * Formats a size for the report: "inf" if unbounded, otherwise
+ * with the requested number of decimal places.
+ */
+
+static const char *formatSize(double size, int decimals, char *buffer, size_t length)
+{
+  if (size == HUGE_VAL) snprintf(buffer, length, "inf");
+  else snprintf(buffer, length, "%.*f", decimals, size);
+  return buffer;
+}
+
+/**
+ * Method: printReport
+ * -------------------
+ * Lists the problems first, then a table with one row per nonterminal,
+ * and ends with a one-line verdict.
+ */
+
+void Analyzer::printReport(ostream& out) const
+{
+  int numNonterminals = grammar.getNumNonterminals();
+  out << numNonterminals << " definitions, " << grammar.getNumProductions() << " productions, "
+      << grammar.getNumSymbols() << " distinct symbols." << endl;
+
+  out << endl << "Undefined symbols (printed verbatim): " << undefinedSymbols.size() << endl;
+  for (size_t i = 0; i < undefinedSymbols.size(); i++)
+    out << "    " << grammar.getSymbolName(undefinedSymbols[i]) << endl;
+
+  vector<int> unreachable, nonterminating;
+  size_t width = strlen("nonterminal");
+  for (int nt = 0; nt < numNonterminals; nt++) {
+    if (!reachable[nt]) unreachable.push_back(nt);
+    if (!canTerminate(nt)) nonterminating.push_back(nt);
+    width = max(width, (size_t) grammar.getSymbolLength(nt));
+  }
+  out << endl << "Unreachable from <start>: " << unreachable.size() << endl;
+  for (size_t i = 0; i < unreachable.size(); i++)
+    out << "    " << grammar.getSymbolName(unreachable[i]) << endl;
+  out << endl << "Can't terminate: " << nonterminating.size() << endl;
+  for (size_t i = 0; i < nonterminating.size(); i++)
+    out << "    " << grammar.getSymbolName(nonterminating[i]) << endl;
+
+  char line[512], min[32], expected[32], maximum[32], expectedSize[32], maxSize[32];
+  out << endl << "Expansion size (terminals and bytes):" << endl;
+  snprintf(line, sizeof(line), "    %-*s %10s %12s %10s %14s %12s", (int) width, "nonterminal",
+           "min", "expected", "max", "expected bytes", "max bytes");
+  out << line << endl;
+  for (int nt = 0; nt < numNonterminals; nt++) {
+    int shortest = grammar.getMinLength(nt);
+    snprintf(line, sizeof(line), "    %-*s %10s %12s %10s %14s %12s", (int) width, grammar.getSymbolName(nt),
+             formatSize(canTerminate(nt) && shortest != Grammar::kUnbounded ? shortest : HUGE_VAL, 0, min, sizeof(min)),
+             formatSize(expectedLengths[nt], 1, expected, sizeof(expected)),
+             formatSize(maxLengths[nt], 0, maximum, sizeof(maximum)),
+             formatSize(expectedBytes[nt], 1, expectedSize, sizeof(expectedSize)),
+             formatSize(maxBytes[nt], 0, maxSize, sizeof(maxSize)));
+    out << line << endl;
+  }
+
+  out << endl << (isAcceptable() ? "Verdict: OK" : "Verdict: REJECT (<start> may never finish expanding)") << endl;
+}
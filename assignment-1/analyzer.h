@@ -0,0 +1,115 @@
+#ifndef __analyzer__
+#define __analyzer__
+
+/**
+ * File: analyzer.h
+ * ----------------
+ * Defines the Analyzer class, which inspects a compiled Grammar
+ * without generating anything from it.  It finds the problems that
+ * make a grammar misbehave when expanded:
+ *
+ *    - nonterminals that can't be reached from <start>,
+ *    - nonterminals that can't terminate (every derivation recurses forever),
+ *    - <symbols> that are used but never defined,
+ *
+ * and it computes, for every nonterminal, the expected and maximum
+ * size of its expansion, both in terminals and in bytes of output.
+ * Both are worked out one strongly connected component of the
+ * "mentions" graph at a time, leaves first: expected sizes (which
+ * follow the production weights) by fixed-point iteration inside each
+ * component, and maximum sizes by checking each component for a cycle
+ * that can pump.  Sizes that grow without bound are reported as
+ * infinite (HUGE_VAL).
+ */
+
+#include "grammar.h"
+#include <iostream>
+#include <vector>
+using namespace std;
+
+class Analyzer {
+
+ public:
+
+  /**
+   * Constructor: Analyzer
+   * ---------------------
+   * Runs every analysis over the specified Grammar, which must
+   * outlive the Analyzer.
+   *
+   * @param grammar the compiled grammar being analyzed.
+   */
+
+  Analyzer(const Grammar& grammar);
+
+  /**
+   * Methods: isReachable, canTerminate
+   * ----------------------------------
+   * Report whether the specified nonterminal can appear in some
+   * expansion of <start>, and whether it has any finite expansion.
+   */
+
+  bool isReachable(int nonterminal) const { return reachable[nonterminal]; }
+  bool canTerminate(int nonterminal) const { return grammar.getShortestProduction(nonterminal) != -1; }
+
+  /**
+   * Method: getUndefinedSymbols
+   * ---------------------------
+   * Returns the IDs of every symbol that looks like a nonterminal
+   * ("<...>") but has no definition, and is therefore printed verbatim.
+   */
+
+  const vector<int>& getUndefinedSymbols() const { return undefinedSymbols; }
+
+  /**
+   * Methods: getExpectedLength, getMaxLength, getExpectedBytes, getMaxBytes
+   * -----------------------------------------------------------------------
+   * Return the expected and the largest possible size of the specified
+   * nonterminal's expansion, counted in terminals or in bytes (each
+   * terminal plus the one separator that follows it).  Unbounded sizes
+   * are HUGE_VAL.
+   */
+
+  double getExpectedLength(int nonterminal) const { return expectedLengths[nonterminal]; }
+  double getMaxLength(int nonterminal) const { return maxLengths[nonterminal]; }
+  double getExpectedBytes(int nonterminal) const { return expectedBytes[nonterminal]; }
+  double getMaxBytes(int nonterminal) const { return maxBytes[nonterminal]; }
+
+  /**
+   * Method: isAcceptable
+   * --------------------
+   * Returns true unless <start> can reach a nonterminal that can't
+   * terminate, or <start>'s expected expansion is unbounded: grammars
+   * that, left to themselves, would loop or exhaust memory.
+   */
+
+  bool isAcceptable() const;
+
+  /**
+   * Method: printReport
+   * -------------------
+   * Prints a human-readable summary of every finding to out.
+   */
+
+  void printReport(ostream& out) const;
+
+ private:
+  const Grammar& grammar;
+  vector<bool> reachable;
+  vector<int> undefinedSymbols;
+  vector<double> expectedLengths;
+  vector<double> maxLengths;
+  vector<double> expectedBytes;
+  vector<double> maxBytes;
+
+  vector<vector<int> > components;        // every strongly connected component, leaves first
+  vector<vector<int> > usableComponents;  // the same, using only productions that can finish
+
+  void computeReachable();
+  void computeComponents(bool usableOnly, vector<vector<int> >& result) const;
+  bool isUsable(int production) const;
+  void computeExpected(const vector<double>& costs, vector<double>& expected) const;
+  void computeMaximum(const vector<double>& costs, vector<double>& maximum) const;
+};
+
+#endif // ! __analyzer__
@@ -0,0 +1,48 @@
+/**
+ * File: arena.cc
+ * --------------
+ * Provides the implementation of the Arena class.
+ */
+
+#include "arena.h"
+#include <algorithm>
+#include <new>
+
+const size_t Arena::kDefaultBlockSize;
+
+Arena::Arena(size_t blockSize) : blockSize(blockSize), block(NULL), used(0), capacity(0) {}
+
+Arena::Arena(const Arena& other) : blockSize(other.blockSize), block(NULL), used(0), capacity(0) {}
+
+Arena::~Arena()
+{
+  reset();
+  ::operator delete(block);
+}
+
+/**
+ * Method: allocateBlock
+ * ---------------------
+ * Starts a block big enough for size bytes and at least twice the size
+ * of the last one, and carves the allocation out of its beginning.
+ * operator new's alignment suits every type the Arena is used for,
+ * and going through it (rather than malloc) lets allocation counters
+ * such as rsg-bench's see the blocks.
+ */
+
+void *Arena::allocateBlock(size_t size)
+{
+  if (block != NULL) full.push_back(block);
+  capacity = max(blockSize, size);
+  blockSize = capacity * 2;
+  block = (char *) ::operator new(capacity);
+  used = size;
+  return block;
+}
+
+void Arena::reset()
+{
+  for (size_t i = 0; i < full.size(); i++) ::operator delete(full[i]);
+  full.clear();
+  used = 0;
+}
@@ -0,0 +1,118 @@
+#ifndef __arena__
+#define __arena__
+
+/**
+ * File: arena.h
+ * -------------
+ * Defines the Arena class, a bump allocator for scratch memory whose
+ * lifetime is one sentence.  Allocating only advances an offset into
+ * the current block, and nothing is freed individually: reset hands
+ * everything back at once.  When a sentence needs more than the
+ * current block holds, a block twice the size is started.  At the next
+ * reset only the newest (largest) block is kept, so after the first
+ * few sentences everything fits in one block and generating a sentence
+ * allocates no memory at all.
+ *
+ * Only plain data (no constructors or destructors) belongs in an Arena.
+ */
+
+#include <vector>
+#include <cstring>
+#include <stddef.h>
+using namespace std;
+
+class Arena {
+
+ public:
+
+  /**
+   * Constant: kDefaultBlockSize
+   * ---------------------------
+   * Size of the first block, which covers the scratch space of
+   * ordinary sentences on its own.
+   */
+
+  static const size_t kDefaultBlockSize = 64 << 10;
+
+  /**
+   * Constructor: Arena
+   * ------------------
+   * Constructs an empty Arena.  No memory is allocated until it's
+   * first needed.
+   *
+   * @param blockSize the size of the first block.
+   */
+
+  Arena(size_t blockSize = kDefaultBlockSize);
+
+  /**
+   * Copy Constructor: Arena
+   * -----------------------
+   * Starts an empty Arena with the same first block size, so that
+   * every worker can be given an Arena of its own by copying.
+   */
+
+  Arena(const Arena& other);
+
+  /**
+   * Destructor: ~Arena
+   * ------------------
+   * Frees every block.
+   */
+
+  ~Arena();
+
+  /**
+   * Method: allocate
+   * ----------------
+   * Returns room for count objects of type T, suitably aligned, that
+   * stays valid until the next reset.
+   */
+
+  template <typename T>
+  T *allocate(size_t count)
+  {
+    size_t start = (used + alignof(T) - 1) & ~(alignof(T) - 1);
+    if (start + count * sizeof(T) > capacity) return (T *) allocateBlock(count * sizeof(T));
+    used = start + count * sizeof(T);
+    return (T *) (block + start);
+  }
+
+  /**
+   * Method: grow
+   * ------------
+   * Replaces an array of capacity objects (allocated from this Arena)
+   * with one twice as large, copying the first count objects across and
+   * updating capacity.  The old array is simply abandoned until reset.
+   */
+
+  template <typename T>
+  T *grow(T *items, size_t count, size_t& capacity)
+  {
+    T *larger = allocate<T>(capacity * 2);
+    memcpy(larger, items, count * sizeof(T));
+    capacity *= 2;
+    return larger;
+  }
+
+  /**
+   * Method: reset
+   * -------------
+   * Reclaims everything allocated since the last reset.  Every block
+   * but the current one is freed.
+   */
+
+  void reset();
+
+ private:
+  size_t blockSize;      // size of the next block to be started
+  char *block;           // the current block
+  size_t used;           // bytes of it handed out
+  size_t capacity;       // its size
+  vector<char *> full;   // older blocks still in use until the next reset
+
+  void *allocateBlock(size_t size);
+  Arena& operator=(const Arena& rhs);
+};
+
+#endif // ! __arena__
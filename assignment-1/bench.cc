@@ -0,0 +1,250 @@
+/**
+ * File: bench.cc
+ * --------------
+ * Provides the implementation of rsg-bench, the generator's benchmark
+ * (run it with "make bench").  Every grammar named on the command line
+ * is loaded and expanded the requested number of times from a fixed
+ * seed, exactly as rsg would expand it, except that the text is thrown
+ * away instead of written.  Each grammar runs in a child process of its
+ * own, so the peak resident set size reported is that grammar's alone.
+ *
+ * For each grammar it reports sentences and bytes per second, peak RSS,
+ * and the number of allocations made while loading and while
+ * generating.  A table goes to standard output, and with --output one
+ * JSON object per grammar is appended to a file, tagged with --label
+ * (the make target uses the current commit), so that runs from
+ * different commits can be compared line by line.
+ */
+
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include "grammar.h"
+#include "random.h"
+#include "expander.h"
+#include "emitter.h"
+#include "arena.h"
+#include "profile.h"
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+using namespace std;
+
+/**
+ * Every allocation the program makes through operator new (which
+ * covers the STL containers and the Arena) is counted here.  The
+ * benchmark is single-threaded, so plain counters will do.
+ */
+
+static size_t allocations = 0;
+static size_t allocatedBytes = 0;
+
+void *operator new(size_t size)
+{
+  allocations++;
+  allocatedBytes += size;
+  void *memory = malloc(size == 0 ? 1 : size);
+  if (memory == NULL) throw bad_alloc();
+  return memory;
+}
+
+void operator delete(void *memory) noexcept { free(memory); }
+void operator delete(void *memory, size_t) noexcept { free(memory); }
+
+/**
+ * What one grammar's run measured.  It's passed from the child process
+ * to the parent through a pipe, so it holds plain data only.
+ */
+
+struct measurement {
+  bool loaded;
+  double loadSeconds;
+  size_t loadAllocations;
+  double seconds;          // generating, after loading
+  long long bytes;         // text generated
+  size_t allocations;      // made while generating
+  size_t allocatedBytes;
+  long peakKilobytes;      // peak resident set size of the whole run
+};
+
+/**
+ * Loads the named grammar and generates count sentences from the
+ * specified seed with the default limits, collecting the text in an
+ * Emitter that's emptied whenever it fills, just as rsg's would be.
+ */
+
+static void measure(const char *fileName, unsigned int count, uint64_t seed, measurement& result)
+{
+  memset(&result, 0, sizeof(result));
+  size_t before = allocations;
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  Grammar grammar(fileName);
+  result.loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  result.loadAllocations = allocations - before;
+  result.loaded = grammar.good();
+  if (!result.loaded) return;
+
+  RandomGenerator random(seed);
+  Expander expander(grammar);
+  Emitter emitter(grammar);
+  Arena scratch;
+  before = allocations;
+  size_t bytesBefore = allocatedBytes;
+  start = chrono::steady_clock::now();
+  for (unsigned int i = 0; i < count; i++) {
+    emitter.beginSentence();
+    scratch.reset();
+    expander.expand(grammar.getStartSymbol(), random, emitter, scratch);
+    emitter.endSentence();
+    if (emitter.size() >= Emitter::kDefaultCapacity) {
+      result.bytes += emitter.size();
+      emitter.clear();
+    }
+  }
+  result.bytes += emitter.size();
+  result.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  result.allocations = allocations - before;
+  result.allocatedBytes = allocatedBytes - bytesBefore;
+
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  result.peakKilobytes = usage.ru_maxrss;
+}
+
+/**
+ * Runs measure in a child process and hands back what it found.
+ *
+ * @return false if the child couldn't be started or didn't report back.
+ */
+
+static bool measureInChild(const char *fileName, unsigned int count, uint64_t seed, measurement& result)
+{
+  int fds[2];
+  if (pipe(fds) != 0) return false;
+  pid_t child = fork();
+  if (child == -1) {
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  if (child == 0) {
+    close(fds[0]);
+    measure(fileName, count, seed, result);
+    bool sent = Emitter::writeFully(fds[1], (const char *) &result, sizeof(result));
+    _exit(sent ? 0 : 1);
+  }
+
+  close(fds[1]);
+  size_t received = 0;
+  while (received < sizeof(result)) {
+    ssize_t got = read(fds[0], (char *) &result + received, sizeof(result) - received);
+    if (got <= 0) break;
+    received += got;
+  }
+  close(fds[0]);
+  int status;
+  waitpid(child, &status, 0);
+  return received == sizeof(result) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * Appends one grammar's results to the history file as a line of JSON,
+ * escaping the label and grammar path like any other JSON string.
+ */
+
+static void appendResult(ofstream& out, const string& label, time_t when, const char *fileName,
+                         unsigned int count, uint64_t seed, const measurement& result)
+{
+  char line[1024];
+  out << "{\"label\": ";
+  Profile::writeString(out, label.data(), label.size());
+  snprintf(line, sizeof(line), ", \"time\": %lld, \"grammar\": ", (long long) when);
+  out << line;
+  Profile::writeString(out, fileName, strlen(fileName));
+  snprintf(line, sizeof(line),
+           ", \"count\": %u, \"seed\": %llu, "
+           "\"load_seconds\": %.6f, \"load_allocations\": %zu, \"seconds\": %.6f, "
+           "\"sentences_per_second\": %.1f, \"bytes\": %lld, \"bytes_per_second\": %.1f, "
+           "\"allocations\": %zu, \"allocated_bytes\": %zu, \"peak_rss_kb\": %ld}",
+           count, (unsigned long long) seed,
+           result.loadSeconds, result.loadAllocations, result.seconds,
+           count / result.seconds, result.bytes, result.bytes / result.seconds,
+           result.allocations, result.allocatedBytes, result.peakKilobytes);
+  out << line << endl;
+}
+
+/**
+ * Prints the usage message to cerr.
+ */
+
+static void printUsage()
+{
+  cerr << "Usage: rsg-bench [--count N] [--seed S] [--label L] [--output <path to history file>]" << endl
+       << "                 <path to grammar file> ..." << endl;
+}
+
+int main(int argc, char *argv[])
+{
+  unsigned int count = 20000;
+  uint64_t seed = 107;
+  string label = "unlabeled";
+  const char *outputFileName = NULL;
+  vector<const char *> grammarFileNames;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "--count" && i + 1 < argc) {
+      count = max(1UL, strtoul(argv[++i], NULL, 10));
+    } else if (arg == "--seed" && i + 1 < argc) {
+      seed = strtoull(argv[++i], NULL, 10);
+    } else if (arg == "--label" && i + 1 < argc) {
+      label = argv[++i];
+    } else if (arg == "--output" && i + 1 < argc) {
+      outputFileName = argv[++i];
+    } else if (arg[0] == '-') {
+      printUsage();
+      return 3;
+    } else {
+      grammarFileNames.push_back(argv[i]);
+    }
+  }
+  if (grammarFileNames.empty()) {
+    printUsage();
+    return 1;
+  }
+
+  ofstream history;
+  if (outputFileName != NULL) {
+    history.open(outputFileName, ios::app);
+    if (!history) {
+      cerr << "Failed to open \"" << outputFileName << "\" for appending." << endl;
+      return 4;
+    }
+  }
+
+  time_t when = time(NULL);
+  int failures = 0;
+  char line[256];
+  snprintf(line, sizeof(line), "%-28s %12s %10s %10s %10s %10s", "grammar", "sentences/s", "MB/s",
+           "peak KB", "load alloc", "gen alloc");
+  cout << line << endl;
+  for (size_t i = 0; i < grammarFileNames.size(); i++) {
+    measurement result;
+    if (!measureInChild(grammarFileNames[i], count, seed, result) || !result.loaded) {
+      cout << grammarFileNames[i] << ": failed" << endl;
+      failures++;
+      continue;
+    }
+    snprintf(line, sizeof(line), "%-28s %12.0f %10.2f %10ld %10zu %10zu", grammarFileNames[i],
+             count / result.seconds, result.bytes / result.seconds / 1e6, result.peakKilobytes,
+             result.loadAllocations, result.allocations);
+    cout << line << endl;
+    if (history.is_open()) appendResult(history, label, when, grammarFileNames[i], count, seed, result);
+  }
+  return failures == 0 ? 0 : 2;
+}
@@ -0,0 +1,46 @@
+/**
+ * File: cache.cc
+ * --------------
+ * Provides the implementation of the GrammarCache class.
+ */
+
+#include "cache.h"
+
+shared_ptr<const Grammar> GrammarCache::get(const string& fileName)
+{
+  struct stat status;
+  if (stat(fileName.c_str(), &status) != 0) return shared_ptr<const Grammar>();
+
+  {
+    lock_guard<mutex> guard(lock);
+    map<string, entry>::iterator found = entries.find(fileName);
+    if (found != entries.end() && isSameFile(found->second.status, status))
+      return found->second.grammar;
+  }
+
+  shared_ptr<const Grammar> grammar = make_shared<const Grammar>(fileName.c_str());
+  if (!grammar->good()) return shared_ptr<const Grammar>();
+
+  lock_guard<mutex> guard(lock);
+  entry& cached = entries[fileName];
+  if (!cached.grammar || !isSameFile(cached.status, status)) {
+    cached.grammar = grammar;
+    cached.status = status;
+  }
+  return grammar;
+}
+
+/**
+ * Method: isSameFile
+ * ------------------
+ * Returns true if two stat results describe the same version of a
+ * file.  Renaming a new file into place changes the inode, and
+ * rewriting one changes its modification time (to the nanosecond,
+ * where the file system records it) or at least its size.
+ */
+
+bool GrammarCache::isSameFile(const struct stat& a, const struct stat& b)
+{
+  return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size &&
+         a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
@@ -0,0 +1,59 @@
+#ifndef __cache__
+#define __cache__
+
+/**
+ * File: cache.h
+ * -------------
+ * Defines the GrammarCache class, which keeps compiled Grammars
+ * resident for a long-running rsg so that each request costs a stat(2)
+ * call rather than a load.  Grammars are handed out as shared_ptrs.
+ * When a file changes on disk, the next request for it loads a fresh
+ * Grammar and installs it for every later request.  Requests already
+ * running keep the Grammar they started with until they finish, so a
+ * reload never pauses or disturbs them.
+ *
+ * A compiled grammar (.gc) is used straight out of its memory mapping,
+ * so it should be replaced by renaming a new file over it rather than
+ * by rewriting it in place.
+ */
+
+#include "grammar.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <sys/stat.h>
+using namespace std;
+
+class GrammarCache {
+
+ public:
+
+  /**
+   * Method: get
+   * -----------
+   * Returns the compiled form of the named grammar file.  The file is
+   * loaded the first time it's asked for, and loaded again whenever its
+   * size, inode or modification time has changed since.  Loading happens
+   * outside the cache's lock, so threads asking for other grammars (or
+   * for an unchanged one) never wait on it.
+   *
+   * @param fileName the path to the grammar file, as given in requests.
+   * @return the Grammar, or an empty pointer if the file can't be loaded.
+   */
+
+  shared_ptr<const Grammar> get(const string& fileName);
+
+ private:
+  struct entry {
+    shared_ptr<const Grammar> grammar;
+    struct stat status;  // the file as it was when grammar was loaded
+  };
+
+  map<string, entry> entries;
+  mutex lock;
+
+  static bool isSameFile(const struct stat& a, const struct stat& b);
+};
+
+#endif // ! __cache__
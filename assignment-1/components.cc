@@ -0,0 +1,87 @@
+/**
+ * File: components.cc
+ * -------------------
+ * Provides the implementation of findComponents.
+ */
+
+#include "components.h"
+#include <algorithm>
+
+void findComponents(const vector<vector<int> >& successors, vector<vector<int> >& components)
+{
+  struct visit {
+    int node;
+    size_t next;  // index of the next successor to look at
+  };
+
+  int numNodes = successors.size();
+  vector<int> index(numNodes, -1), lowlink(numNodes, 0);
+  vector<bool> onStack(numNodes, false);
+  vector<int> unassigned;
+  vector<visit> path;
+  int counter = 0;
+  components.clear();
+
+  for (int root = 0; root < numNodes; root++) {
+    if (index[root] != -1) continue;
+    int next = root;
+    while (true) {
+      if (next != -1) {
+        index[next] = lowlink[next] = counter++;
+        unassigned.push_back(next);
+        onStack[next] = true;
+        visit start = { next, 0 };
+        path.push_back(start);
+        next = -1;
+      }
+      if (path.empty()) break;
+
+      visit& top = path.back();
+      const vector<int>& out = successors[top.node];
+      while (next == -1 && top.next < out.size()) {
+        int node = out[top.next++];
+        if (index[node] == -1) next = node;
+        else if (onStack[node]) lowlink[top.node] = min(lowlink[top.node], index[node]);
+      }
+      if (next != -1) continue;
+
+      int node = top.node;
+      path.pop_back();
+      if (!path.empty()) lowlink[path.back().node] = min(lowlink[path.back().node], lowlink[node]);
+      if (lowlink[node] == index[node]) {
+        components.push_back(vector<int>());
+        int member;
+        do {
+          member = unassigned.back();
+          unassigned.pop_back();
+          onStack[member] = false;
+          components.back().push_back(member);
+        } while (member != node);
+      }
+    }
+  }
+}
+
+void findSameLengthComponents(const Grammar& grammar, vector<vector<int> >& successors,
+                              vector<vector<int> >& components)
+{
+  successors.assign(grammar.getNumNonterminals(), vector<int>());
+  for (int nt = 0; nt < grammar.getNumNonterminals(); nt++) {
+    for (int p = grammar.getFirstProduction(nt); p < grammar.getFirstProduction(nt) + grammar.getNumProductions(nt); p++) {
+      int nonEmpty = 0, last = -1;
+      for (const int *curr = grammar.productionBegin(p); curr != grammar.productionEnd(p); ++curr)
+        if (grammar.getMinLength(*curr) != 0) nonEmpty++, last = *curr;
+      for (const int *curr = grammar.productionBegin(p); curr != grammar.productionEnd(p); ++curr) {
+        if (!grammar.isNonterminal(*curr) || grammar.getMinLength(*curr) == Grammar::kUnbounded) continue;
+        if (nonEmpty == 0 || (nonEmpty == 1 && *curr == last)) successors[nt].push_back(*curr);
+      }
+    }
+  }
+  findComponents(successors, components);
+}
+
+bool isCyclic(const vector<int>& component, const vector<vector<int> >& successors)
+{
+  const vector<int>& out = successors[component[0]];
+  return component.size() > 1 || find(out.begin(), out.end(), component[0]) != out.end();
+}
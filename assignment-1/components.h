@@ -0,0 +1,59 @@
+#ifndef __components__
+#define __components__
+
+/**
+ * File: components.h
+ * ------------------
+ * Declares findComponents, which splits a directed graph over the
+ * nonterminals of a Grammar into strongly connected components.  The
+ * Analyzer, the Sampler and the ConstrainedExpander all work through
+ * the nonterminals one component at a time, starting with the
+ * components nothing else depends on.
+ */
+
+#include "grammar.h"
+#include <vector>
+using namespace std;
+
+/**
+ * Function: findComponents
+ * ------------------------
+ * Runs Tarjan's algorithm, on an explicit stack so that long chains
+ * can't overflow the call stack.  Tarjan's algorithm only finishes a
+ * component after every component it points to, so the result lists
+ * them leaves first.
+ *
+ * @param successors node -> the nodes it points to.
+ * @param components filled with every component, leaves first.
+ */
+
+void findComponents(const vector<vector<int> >& successors, vector<vector<int> >& components);
+
+/**
+ * Function: findSameLengthComponents
+ * ----------------------------------
+ * Builds the graph in which <a> points to <b> when one of <a>'s
+ * productions mentions <b> and every other symbol of it can expand to
+ * nothing, so that what <a> can do at some length depends on what <b>
+ * can do at that same length, and splits it into components, leaves
+ * first.  Tables filled in one length at a time visit nonterminals in
+ * this order.  Nonterminals that can't terminate are never pointed to.
+ *
+ * @param grammar the compiled grammar.
+ * @param successors filled with nonterminal -> the nonterminals it points to.
+ * @param components filled with every component, leaves first.
+ */
+
+void findSameLengthComponents(const Grammar& grammar, vector<vector<int> >& successors,
+                              vector<vector<int> >& components);
+
+/**
+ * Function: isCyclic
+ * ------------------
+ * Returns true if the specified component of the graph has a cycle:
+ * more than one member, or a member that points to itself.
+ */
+
+bool isCyclic(const vector<int>& component, const vector<vector<int> >& successors);
+
+#endif // ! __components__
@@ -0,0 +1,295 @@
+/**
+ * File: constrained.cc
+ * --------------------
+ * Provides the implementation of the ConstrainedExpander class.
+ */
+
+#include "constrained.h"
+#include "components.h"
+#include <algorithm>
+
+const size_t ConstrainedExpander::kInitialStackSize;
+const unsigned char ConstrainedExpander::kFeasible;
+const unsigned char ConstrainedExpander::kIncludes;
+
+/**
+ * Constructor: ConstrainedExpander
+ * --------------------------------
+ * Fills in the tables one length at a time, in the same order the
+ * Sampler fills in its counts: a suffix's flags at length n combine,
+ * over every split of n between its first symbol and the rest, the
+ * flags of the two parts, and the few that need flags at n itself
+ * come from symbols that can produce nothing.  So nonterminals are
+ * visited leaves first in the "same length" graph, and the members of
+ * a cycle in it are revisited until their flags at n stop changing.
+ * Flags only ever get set, so that happens within a pass per member.
+ */
+
+ConstrainedExpander::ConstrainedExpander(const Grammar& grammar, int minLength, int maxLength, int required) :
+  grammar(grammar), minLength(max(0, minLength)), maxLength(max(this->minLength, maxLength)),
+  required(required), width((size_t) this->maxLength + 1), wanted(required == -1 ? kFeasible : kIncludes),
+  items(grammar.productionBegin(0))
+{
+  int numItems = grammar.productionBegin(grammar.getNumProductions()) - items;
+  suffixMinLengths.resize(numItems);
+  for (int p = 0; p < grammar.getNumProductions(); p++) {
+    long long minLength = 0;
+    for (const int *curr = grammar.productionEnd(p); curr != grammar.productionBegin(p); ) {
+      --curr;
+      minLength = min<long long>(Grammar::kUnbounded, minLength + grammar.getMinLength(*curr));
+      suffixMinLengths[curr - items] = minLength;
+    }
+  }
+
+  vector<vector<int> > successors, components;
+  findSameLengthComponents(grammar, successors, components);
+
+  flags.assign((size_t) grammar.getNumNonterminals() * width, 0);
+  suffixFlags.assign((size_t) numItems * width, 0);
+  for (int n = 0; n <= this->maxLength; n++) {
+    for (size_t c = 0; c < components.size(); c++) {
+      const vector<int>& members = components[c];
+      bool cyclic = isCyclic(members, successors);
+      bool changed = true;
+      while (changed) {
+        changed = false;
+        for (size_t i = 0; i < members.size(); i++) {
+          int nt = members[i];
+          unsigned char found = 0;
+          for (int p = grammar.getFirstProduction(nt); p < grammar.getFirstProduction(nt) + grammar.getNumProductions(nt); p++)
+            found |= fillSuffixes(p, n);
+          if (found != flags[nt * width + n]) changed = true;
+          flags[nt * width + n] = found;
+        }
+        changed = changed && cyclic;
+      }
+    }
+    for (int p = 0; p < grammar.getNumProductions(); p++)
+      fillSuffixes(p, n);
+  }
+}
+
+/**
+ * Function: join
+ * --------------
+ * Returns the flags of a sequence whose first symbol has the flags
+ * first (for its share of the length) and whose remaining symbols have
+ * the flags rest (for theirs).  The sequence includes the required
+ * terminal if either part does, provided the other part is feasible.
+ */
+
+unsigned char ConstrainedExpander::join(unsigned char first, unsigned char rest)
+{
+  unsigned char joined = first & rest & kFeasible;
+  if (((first & kIncludes) && (rest & kFeasible)) || ((first & kFeasible) && (rest & kIncludes)))
+    joined |= kIncludes;
+  return joined;
+}
+
+/**
+ * Method: fillSuffixes
+ * --------------------
+ * Fills in the length n flags of every suffix of the specified
+ * production, last symbol first, and returns the flags of the whole
+ * production.  Splits are limited to those where each side can reach
+ * its share, given the grammar's minimum lengths, and the search stops
+ * as soon as every flag has been found.
+ */
+
+unsigned char ConstrainedExpander::fillSuffixes(int production, int n)
+{
+  unsigned char all = kFeasible | (required == -1 ? 0 : kIncludes);
+  const int *begin = grammar.productionBegin(production), *end = grammar.productionEnd(production);
+  for (const int *curr = end; curr != begin; ) {
+    --curr;
+    unsigned char found = 0;
+    if (!grammar.isNonterminal(*curr)) {
+      if (n > 0) found = join(symbolFlags(*curr, 1), suffix(curr + 1, end, n - 1));
+    } else {
+      int high = n - suffixMinLength(curr + 1, end);
+      for (int m = grammar.getMinLength(*curr); m <= high && found != all; m++)
+        found |= join(symbolFlags(*curr, m), suffix(curr + 1, end, n - m));
+    }
+    suffixFlags[(curr - items) * width + n] = found;
+  }
+  return suffix(begin, end, n);
+}
+
+bool ConstrainedExpander::canExpand(int symbol) const
+{
+  for (int n = minLength; n <= maxLength; n++)
+    if (symbolFlags(symbol, n) & wanted) return true;
+  return false;
+}
+
+/**
+ * Method: expand
+ * --------------
+ * Keeps an explicit stack of open productions, each with the number
+ * of terminals its remaining symbols still have to produce and whether
+ * they still owe the required terminal.  Each symbol is handed a share
+ * of that, and possibly the debt, that leaves the rest feasible, and
+ * each nonterminal is given a production that can meet what it was
+ * handed, so the expansion never gets stuck.  A nonterminal handed
+ * no terminals and no debt is skipped rather than expanded: it can't
+ * print anything, and expanding it could take arbitrarily long in a
+ * grammar like <list> -> <list> <list> where <list> can be empty.
+ */
+
+bool ConstrainedExpander::expand(int symbol, RandomGenerator& random, Emitter& out, Arena& scratch, Profile *profile) const
+{
+  if (!canExpand(symbol)) return false;
+  int length = chooseLength(symbol, random);
+  if (!grammar.isNonterminal(symbol)) {
+    out.emit(symbol);
+    if (profile != NULL) profile->recordTerminal(-1);
+    return true;
+  }
+
+  struct frame {
+    const int *curr;     // next symbol of the open production
+    const int *end;      // one past its last symbol
+    int length;          // terminals the symbols from curr on must produce
+    unsigned char need;  // kIncludes if they must produce the required terminal, kFeasible if not
+    int nonterminal;     // the nonterminal it expands
+  };
+
+  size_t capacity = kInitialStackSize, depth = 0;
+  frame *stack = scratch.allocate<frame>(capacity);
+  int production = chooseProduction(symbol, length, wanted, random);
+  if (profile != NULL) {
+    profile->recordExpansion(symbol, production, 0, false);
+    profile->recordSubtree(symbol, length);
+  }
+  frame root = { grammar.productionBegin(production), grammar.productionEnd(production), length, wanted, symbol };
+  stack[depth++] = root;
+  while (depth > 0) {
+    frame& top = stack[depth - 1];
+    if (top.curr == top.end) {
+      depth--;
+      continue;
+    }
+
+    int next = *top.curr;
+    unsigned char need, restNeed;
+    int n = chooseSplit(top.curr, top.end, top.length, top.need, need, restNeed, random);
+    top.curr++;
+    top.length -= n;
+    top.need = restNeed;
+    if (!grammar.isNonterminal(next)) {
+      out.emit(next);
+      if (profile != NULL) profile->recordTerminal(top.nonterminal);
+      continue;
+    }
+    if (n == 0 && need == kFeasible) continue;  // it would print nothing, however it's expanded
+
+    production = chooseProduction(next, n, need, random);
+    if (profile != NULL) {
+      profile->recordExpansion(next, production, depth, false);
+      profile->recordSubtree(next, n);
+    }
+    frame child = { grammar.productionBegin(production), grammar.productionEnd(production), n, need, next };
+    if (depth == capacity) stack = scratch.grow(stack, depth, capacity);
+    stack[depth++] = child;
+  }
+  return true;
+}
+
+/**
+ * Method: chooseLength
+ * --------------------
+ * Picks the length of the whole expansion uniformly among the lengths
+ * of the window the symbol can produce under the constraints.
+ */
+
+int ConstrainedExpander::chooseLength(int symbol, RandomGenerator& random) const
+{
+  int feasible = 0;
+  for (int n = minLength; n <= maxLength; n++)
+    if (symbolFlags(symbol, n) & wanted) feasible++;
+  int target = random.getRandomInteger(0, feasible - 1);
+  for (int n = minLength; n <= maxLength; n++)
+    if ((symbolFlags(symbol, n) & wanted) && target-- == 0) return n;
+  return -1;
+}
+
+/**
+ * Method: chooseProduction
+ * ------------------------
+ * Picks one of the nonterminal's productions that can produce exactly
+ * n terminals with the flag need, in proportion to the weights of
+ * those productions.  If rounding leaves the draw unclaimed, the last
+ * of them is used.
+ */
+
+int ConstrainedExpander::chooseProduction(int nonterminal, int n, unsigned char need, RandomGenerator& random) const
+{
+  int first = grammar.getFirstProduction(nonterminal), last = first + grammar.getNumProductions(nonterminal);
+  double total = 0;
+  for (int p = first; p < last; p++)
+    if (suffix(grammar.productionBegin(p), grammar.productionEnd(p), n) & need) total += grammar.getProductionWeight(p);
+
+  double target = random.getRandomReal() * total;
+  int chosen = -1;
+  for (int p = first; p < last; p++) {
+    if (!(suffix(grammar.productionBegin(p), grammar.productionEnd(p), n) & need)) continue;
+    chosen = p;
+    double weight = grammar.getProductionWeight(p);
+    if (target < weight) break;
+    target -= weight;
+  }
+  return chosen;
+}
+
+/**
+ * Method: chooseSplit
+ * -------------------
+ * Picks how many of the n terminals owed from curr on come from the
+ * symbol at curr, and, when the suffix still owes the required
+ * terminal, whether that symbol or the rest of the suffix provides it.
+ * Every choice that leaves both sides feasible is equally likely.
+ *
+ * @param need the flag the suffix from curr on must have.
+ * @param firstNeed set to the flag the symbol at curr must have.
+ * @param restNeed set to the flag the symbols after it must have.
+ * @return the symbol's share of n.
+ */
+
+int ConstrainedExpander::chooseSplit(const int *curr, const int *end, int n, unsigned char need,
+                                     unsigned char& firstNeed, unsigned char& restNeed, RandomGenerator& random) const
+{
+  int low = grammar.getMinLength(*curr), high = n - suffixMinLength(curr + 1, end);
+  int choices = 0;
+  for (int m = low; m <= high; m++) {
+    unsigned char first = symbolFlags(*curr, m), rest = suffix(curr + 1, end, n - m);
+    if (need == kFeasible) {
+      if (first & rest & kFeasible) choices++;
+    } else {
+      if ((first & kIncludes) && (rest & kFeasible)) choices++;
+      if ((first & kFeasible) && (rest & kIncludes)) choices++;
+    }
+  }
+
+  int target = random.getRandomInteger(0, choices - 1);
+  for (int m = low; m <= high; m++) {
+    unsigned char first = symbolFlags(*curr, m), rest = suffix(curr + 1, end, n - m);
+    if (need == kFeasible) {
+      if ((first & rest & kFeasible) && target-- == 0) {
+        firstNeed = restNeed = kFeasible;
+        return m;
+      }
+    } else {
+      if ((first & kIncludes) && (rest & kFeasible) && target-- == 0) {
+        firstNeed = kIncludes;
+        restNeed = kFeasible;
+        return m;
+      }
+      if ((first & kFeasible) && (rest & kIncludes) && target-- == 0) {
+        firstNeed = kFeasible;
+        restNeed = kIncludes;
+        return m;
+      }
+    }
+  }
+  return -1;
+}
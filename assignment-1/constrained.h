@@ -0,0 +1,128 @@
+#ifndef __constrained__
+#define __constrained__
+
+/**
+ * File: constrained.h
+ * -------------------
+ * Defines the ConstrainedExpander class, which expands a compiled
+ * Grammar the way the Expander does, except that every expansion is
+ * guaranteed to satisfy two constraints fixed up front:
+ *
+ *    - its number of terminals lies within a window [minLength, maxLength], and
+ *    - (optionally) it contains one required terminal somewhere.
+ *
+ * Rather than generating sentences and throwing away the ones that
+ * miss, construction works out, for every nonterminal and every suffix
+ * of every production, which lengths in the window it can produce at
+ * all, and which it can produce while including the required terminal.
+ * Expansion then never opens a production, or splits a length between
+ * symbols, that can't be completed, so every sentence is accepted the
+ * first time.
+ *
+ * Among the productions that remain feasible, choices follow the
+ * grammar's weights (or are uniform), just as in the Expander.  The
+ * sentence's length is chosen uniformly among the feasible lengths of
+ * the window, and each symbol's share of its production's length
+ * uniformly among the shares that leave the rest feasible.
+ */
+
+#include "grammar.h"
+#include "random.h"
+#include "emitter.h"
+#include "arena.h"
+#include "profile.h"
+#include <vector>
+using namespace std;
+
+class ConstrainedExpander {
+
+ public:
+
+  /**
+   * Constructor: ConstrainedExpander
+   * --------------------------------
+   * Works out which lengths from 0 through maxLength every nonterminal
+   * and production suffix of the specified Grammar (which must outlive
+   * the ConstrainedExpander) can produce, with and without the required
+   * terminal.  Takes time proportional to the total size of the
+   * productions times maxLength squared at worst, and space
+   * proportional to their size times maxLength.  Once built, a
+   * ConstrainedExpander is read-only and may be shared between threads.
+   *
+   * @param grammar the compiled grammar being expanded.
+   * @param minLength the fewest terminals an expansion may produce.
+   * @param maxLength the most terminals an expansion may produce.
+   * @param required the ID of a terminal every expansion must contain,
+   *                 or -1 if there's no such requirement.
+   */
+
+  ConstrainedExpander(const Grammar& grammar, int minLength, int maxLength, int required = -1);
+
+  /**
+   * Method: canExpand
+   * -----------------
+   * Returns true if the specified symbol has any expansion that
+   * satisfies the constraints.
+   */
+
+  bool canExpand(int symbol) const;
+
+  /**
+   * Method: expand
+   * --------------
+   * Streams to out the terminals of one expansion of the specified
+   * symbol that satisfies the constraints.  Runs in time proportional
+   * to the number of symbols expanded times the length of the window.
+   * The caller frames the sentence with out.beginSentence() and
+   * out.endSentence(), and resets the Arena the stack lives in between
+   * sentences.
+   *
+   * @param symbol the ID of the terminal or nonterminal being expanded.
+   * @param random the generator used to make every choice.
+   * @param out the Emitter the terminals are passed to.
+   * @param scratch the Arena the stack is allocated from.
+   * @param profile the Profile to record the expansion in, or NULL.
+   * @return false (having emitted nothing) if canExpand(symbol) is false.
+   */
+
+  bool expand(int symbol, RandomGenerator& random, Emitter& out, Arena& scratch, Profile *profile = NULL) const;
+
+ private:
+  static const size_t kInitialStackSize = 64;  // frames allocated before the stack first grows
+
+  // Each table entry holds these flags for one symbol (or suffix) and length.
+  static const unsigned char kFeasible = 1;   // some expansion has the length
+  static const unsigned char kIncludes = 2;   // some expansion has the length and contains the required terminal
+
+  const Grammar& grammar;
+  int minLength;
+  int maxLength;
+  int required;
+  size_t width;                         // maxLength + 1 entries per row
+  unsigned char wanted;                 // flags a whole expansion needs: kIncludes, or kFeasible without a requirement
+  const int *items;                     // start of the grammar's production symbols
+  vector<unsigned char> flags;          // nonterminal x length -> its flags
+  vector<unsigned char> suffixFlags;    // item x length -> flags of the item through the end of its production
+  vector<int> suffixMinLengths;         // item -> fewest terminals from the item through the end of its production
+
+  unsigned char symbolFlags(int symbol, int n) const
+  {
+    if (!grammar.isNonterminal(symbol)) return n != 1 ? 0 : (symbol == required ? kFeasible | kIncludes : kFeasible);
+    return flags[symbol * width + n];
+  }
+  unsigned char suffix(const int *curr, const int *end, int n) const
+  {
+    if (curr == end) return n == 0 ? kFeasible : 0;
+    return suffixFlags[(curr - items) * width + n];
+  }
+  int suffixMinLength(const int *curr, const int *end) const { return curr == end ? 0 : suffixMinLengths[curr - items]; }
+
+  static unsigned char join(unsigned char first, unsigned char rest);
+  unsigned char fillSuffixes(int production, int n);
+  int chooseLength(int symbol, RandomGenerator& random) const;
+  int chooseProduction(int nonterminal, int n, unsigned char need, RandomGenerator& random) const;
+  int chooseSplit(const int *curr, const int *end, int n, unsigned char need,
+                  unsigned char& firstNeed, unsigned char& restNeed, RandomGenerator& random) const;
+};
+
+#endif // ! __constrained__
@@ -0,0 +1,132 @@
+/**
+ * File: emitter.cc
+ * ----------------
+ * Provides the implementation of the Emitter class.
+ */
+
+#include "emitter.h"
+#include <algorithm>
+#include <errno.h>
+#include <unistd.h>
+
+const size_t Emitter::kDefaultCapacity;
+
+/**
+ * Sentence layout, matching the original printTerminals: a five
+ * space indent on the first line and a 55 column limit.
+ */
+
+static const char kIndent[] = "     ";
+static const unsigned int kLineLimit = 55;
+
+/**
+ * Constructor: Emitter
+ * --------------------
+ * Builds the per-symbol length and punctuation tables.  Tables cover
+ * nonterminals too, since the Expander emits a nonterminal that can't
+ * terminate as if it were a word.
+ */
+
+Emitter::Emitter(const Grammar& grammar, int fd, size_t capacity, bool wrapped) :
+  grammar(grammar), fd(fd), capacity(capacity), wrapped(wrapped), failed(false), buffer(capacity), used(0), held(-1),
+  lineLength(0)
+{
+  lengths.resize(grammar.getNumSymbols());
+  isPunctuation.resize(grammar.getNumSymbols());
+  for (int symbol = 0; symbol < grammar.getNumSymbols(); symbol++) {
+    const char *name = grammar.getSymbolName(symbol);
+    lengths[symbol] = grammar.getSymbolLength(symbol);
+    isPunctuation[symbol] = (lengths[symbol] == 1 && strchr(".!,?;", name[0]) != NULL);
+  }
+}
+
+Emitter::Emitter(const Emitter& other) :
+  grammar(other.grammar), fd(other.fd), capacity(other.capacity), wrapped(other.wrapped), failed(false),
+  buffer(other.capacity), used(0), lengths(other.lengths), isPunctuation(other.isPunctuation), held(-1), lineLength(0) {}
+
+Emitter::~Emitter()
+{
+  flush();
+}
+
+void Emitter::beginSentence()
+{
+  if (wrapped) put(kIndent, sizeof(kIndent) - 1);
+  lineLength = wrapped ? sizeof(kIndent) - 1 : 0;
+  held = -1;
+}
+
+void Emitter::endSentence()
+{
+  if (held != -1) place(held, true);  // the last word never gets a trailing space
+  held = -1;
+  put('\n');
+}
+
+void Emitter::append(const char *text, size_t length)
+{
+  put(text, length);
+}
+
+/**
+ * Method: place
+ * -------------
+ * Formats one terminal now that we know whether its successor is
+ * punctuation.  Words followed by punctuation are glued to it and
+ * never wrap; every other word gets a trailing space and moves to a
+ * fresh line if it would cross the column limit (when wrapping).
+ */
+
+void Emitter::place(int terminal, bool nextIsPunctuation)
+{
+  const char *word = grammar.getSymbolName(terminal);
+  unsigned int length = lengths[terminal];
+  if (nextIsPunctuation) {
+    put(word, length);
+    lineLength += length;
+  } else if (wrapped && lineLength + 1 + length > kLineLimit) {
+    put('\n');
+    put(word, length);
+    put(' ');
+    lineLength = length + 1;
+  } else {
+    put(word, length);
+    put(' ');
+    lineLength += length + 1;
+  }
+}
+
+/**
+ * Method: reserve
+ * ---------------
+ * Makes room for length more bytes, first by writing the buffer out
+ * (if there's somewhere to write it) and otherwise by growing it.
+ */
+
+void Emitter::reserve(size_t length)
+{
+  if (used + length <= buffer.size()) return;
+  if (fd != -1) flush();
+  if (used + length > buffer.size()) buffer.resize(max(2 * buffer.size(), used + length));
+}
+
+void Emitter::flush()
+{
+  if (fd == -1 || used == 0) return;
+  if (!writeFully(fd, buffer.data(), used)) failed = true;
+  used = 0;
+}
+
+bool Emitter::writeFully(int fd, const char *text, size_t length)
+{
+  while (length > 0) {
+    ssize_t written = write(fd, text, length);
+    if (written < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    text += written;
+    length -= written;
+  }
+  return true;
+}
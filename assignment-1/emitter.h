@@ -0,0 +1,168 @@
+#ifndef __emitter__
+#define __emitter__
+
+/**
+ * File: emitter.h
+ * ---------------
+ * Defines the Emitter class, which formats terminals straight into
+ * one large, reusable output buffer as the Expander produces them.
+ * It word-wraps exactly the way the original printTerminals did, but
+ * with each terminal's length and punctuation flag looked up in tables
+ * built once per Grammar, and it hands the text to the OS a buffer at
+ * a time with write(2) instead of piece by piece through cout.
+ *
+ * Whether a space goes after a word depends on whether the *next*
+ * word is punctuation, so the Emitter holds back one terminal and
+ * formats it when its successor (or the end of the sentence) arrives.
+ */
+
+#include "grammar.h"
+#include <vector>
+#include <cstring>
+#include <stddef.h>
+using namespace std;
+
+class Emitter {
+
+ public:
+
+  /**
+   * Constant: kDefaultCapacity
+   * --------------------------
+   * Buffer size at which an Emitter attached to a file descriptor
+   * writes its contents out.
+   */
+
+  static const size_t kDefaultCapacity = 1 << 20;
+
+  /**
+   * Constructor: Emitter
+   * --------------------
+   * Constructs an Emitter for terminals of the specified Grammar,
+   * which must outlive it.  If fd is a valid file descriptor, the
+   * buffer is written to it whenever it fills past capacity and when
+   * the Emitter is destroyed.  If fd is -1, the buffer just grows until
+   * the client takes the text with data()/size() and calls clear(),
+   * which is how worker threads hand their output to a single writer.
+   * An Emitter that isn't wrapped puts each sentence on one line of its
+   * own, with no indent, which is what a text corpus wants.
+   *
+   * @param grammar the compiled grammar whose terminals are emitted.
+   * @param fd the file descriptor to write to, or -1 to only buffer.
+   * @param capacity the buffer size that triggers a write.
+   * @param wrapped whether sentences are indented and wrapped.
+   */
+
+  Emitter(const Grammar& grammar, int fd = -1, size_t capacity = kDefaultCapacity, bool wrapped = true);
+
+  /**
+   * Copy Constructor: Emitter
+   * -------------------------
+   * Copies the tables but starts with an empty buffer, so that
+   * one prototype Emitter can be cloned for every worker.
+   */
+
+  Emitter(const Emitter& other);
+
+  /**
+   * Destructor: ~Emitter
+   * --------------------
+   * Flushes whatever is still buffered (when attached to a descriptor).
+   */
+
+  ~Emitter();
+
+  /**
+   * Methods: beginSentence, emit, endSentence
+   * -----------------------------------------
+   * A sentence is framed by beginSentence and endSentence, and each of
+   * its terminals is passed to emit in order.  The text is indented by
+   * five spaces and wrapped at 55 columns (unless the Emitter isn't
+   * wrapped), and ends with a newline.
+   */
+
+  void beginSentence();
+  void emit(int terminal)
+  {
+    if (held != -1) place(held, isPunctuation[terminal]);
+    held = terminal;
+  }
+  void endSentence();
+
+  /**
+   * Method: append
+   * --------------
+   * Copies arbitrary text (banners, blank lines) into the buffer.
+   */
+
+  void append(const char *text, size_t length);
+
+  /**
+   * Method: flush
+   * -------------
+   * Writes the buffered text to the file descriptor and empties the
+   * buffer.  Does nothing if the Emitter isn't attached to one.
+   */
+
+  void flush();
+
+  /**
+   * Method: good
+   * ------------
+   * Returns false once any write to the file descriptor has failed,
+   * whether from flush or because the buffer filled up.
+   */
+
+  bool good() const { return !failed; }
+
+  /**
+   * Methods: data, size, clear
+   * --------------------------
+   * Give direct access to the buffered text, and discard it.
+   */
+
+  const char *data() const { return buffer.data(); }
+  size_t size() const { return used; }
+  void clear() { used = 0; }
+
+  /**
+   * Method: isWrapped
+   * -----------------
+   * Returns true if sentences are indented and wrapped.
+   */
+
+  bool isWrapped() const { return wrapped; }
+
+  /**
+   * Function: writeFully
+   * --------------------
+   * Writes all length bytes to fd, retrying after short writes and
+   * interruptions.
+   *
+   * @return true if every byte was written, false on error.
+   */
+
+  static bool writeFully(int fd, const char *text, size_t length);
+
+ private:
+  const Grammar& grammar;
+  int fd;
+  size_t capacity;
+  bool wrapped;
+  bool failed;                       // whether a write to fd has failed
+  vector<char> buffer;
+  size_t used;
+  vector<unsigned int> lengths;      // symbol ID -> length of its text
+  vector<char> isPunctuation;        // symbol ID -> whether it's . ! , ? or ;
+  int held;                          // terminal waiting to see its successor, or -1
+  unsigned int lineLength;
+
+  void place(int terminal, bool nextIsPunctuation);
+  void reserve(size_t length);
+  void put(const char *text, size_t length) { reserve(length); memcpy(buffer.data() + used, text, length); used += length; }
+  void put(char ch) { reserve(1); buffer[used++] = ch; }
+
+  Emitter& operator=(const Emitter& rhs);
+};
+
+#endif // ! __emitter__
@@ -0,0 +1,105 @@
+/**
+ * File: expander.cc
+ * -----------------
+ * Provides the implementation of the Expander class.
+ */
+
+#include "expander.h"
+
+const int Expander::kDefaultMaxDepth;
+const int Expander::kDefaultMaxLength;
+const size_t Expander::kInitialStackSize;
+
+/**
+ * Constructor: Expander
+ * ---------------------
+ * Precomputes the budget of every symbol and production: the number
+ * of terminals it's guaranteed to produce once shortest productions
+ * take over.  That's the grammar's minimum length, except that a
+ * nonterminal that can't terminate is emitted verbatim and so costs 1.
+ */
+
+Expander::Expander(const Grammar& grammar, int maxDepth, int maxLength) :
+  grammar(grammar), maxDepth(maxDepth), maxLength(maxLength)
+{
+  symbolBudgets.resize(grammar.getNumNonterminals());
+  for (int nt = 0; nt < grammar.getNumNonterminals(); nt++)
+    symbolBudgets[nt] = (grammar.getShortestProduction(nt) == -1) ? 1 : grammar.getMinLength(nt);
+
+  productionBudgets.assign(grammar.getNumProductions(), 0);
+  for (int p = 0; p < grammar.getNumProductions(); p++)
+    for (const int *curr = grammar.productionBegin(p); curr != grammar.productionEnd(p); ++curr)
+      productionBudgets[p] += getBudget(*curr);
+}
+
+/**
+ * Method: expand
+ * --------------
+ * Walks the derivation depth-first with an explicit stack of open
+ * productions.  pending tracks the budget still owed by every symbol
+ * that's been pushed but not yet read, so before committing to a
+ * random production we can check that the terminals emitted so far,
+ * plus everything already owed, plus what the new production owes,
+ * still fit in maxLength.  If they don't, or if the stack is already
+ * maxDepth deep, the nonterminal gets its shortest production instead,
+ * whose budget is exactly the budget already reserved for it.  A
+ * nonterminal with an empty definition has nothing to choose from,
+ * so it goes straight to the same fallback and is emitted as is.  Each
+ * frame remembers which nonterminal it expands and how many terminals
+ * had been produced when it opened, which is all a Profile needs.
+ */
+
+bool Expander::expand(int symbol, RandomGenerator& random, Emitter& out, Arena& scratch, Profile *profile) const
+{
+  bool withinLimits = true;
+  long long produced = 0;
+  long long pending = getBudget(symbol);
+  size_t capacity = kInitialStackSize, depth = 0;
+  frame *stack = scratch.allocate<frame>(capacity);
+  frame root = { &symbol, &symbol + 1, -1, 0 };
+  stack[depth++] = root;
+
+  while (depth > 0) {
+    frame& top = stack[depth - 1];
+    if (top.curr == top.end) {
+      if (profile != NULL && top.nonterminal != -1) profile->recordSubtree(top.nonterminal, produced - top.produced);
+      depth--;
+      continue;
+    }
+
+    int next = *top.curr++;
+    pending -= getBudget(next);
+    if (!grammar.isNonterminal(next)) {
+      out.emit(next);
+      produced++;
+      if (profile != NULL) profile->recordTerminal(top.nonterminal);
+      continue;
+    }
+
+    int prod = -1;
+    bool forced = false;
+    if ((long long) depth < maxDepth && grammar.getNumProductions(next) > 0) {
+      prod = grammar.getRandomProduction(next, random);
+      if (produced + pending + productionBudgets[prod] > maxLength) prod = -1;
+    }
+    if (prod == -1) {
+      withinLimits = false;
+      forced = true;
+      prod = grammar.getShortestProduction(next);
+      if (prod == -1) {  // can't terminate at all, so emit it as is
+        out.emit(next);
+        produced++;
+        if (profile != NULL) profile->recordTerminal(top.nonterminal);
+        continue;
+      }
+    }
+
+    if (profile != NULL) profile->recordExpansion(next, prod, depth - 1, forced);
+    pending += productionBudgets[prod];
+    frame opened = { grammar.productionBegin(prod), grammar.productionEnd(prod), next, produced };
+    if (depth == capacity) stack = scratch.grow(stack, depth, capacity);
+    stack[depth++] = opened;
+  }
+
+  return withinLimits;
+}
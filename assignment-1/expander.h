@@ -0,0 +1,98 @@
+#ifndef __expander__
+#define __expander__
+
+/**
+ * File: expander.h
+ * ----------------
+ * Defines the Expander class, which turns a symbol of a compiled
+ * Grammar into a sequence of terminal IDs.  The expansion runs on an
+ * explicit stack rather than the C++ call stack, and two limits keep
+ * every expansion bounded:
+ *
+ *    - maxDepth caps how many productions may be open at once, and
+ *    - maxLength caps how many terminals a single expansion may emit.
+ *
+ * Once either limit would be crossed, every further nonterminal is
+ * expanded with its shortest production (see Grammar::getShortestProduction),
+ * which is guaranteed to finish.  Nonterminals that can't terminate at
+ * all are emitted verbatim, the same way an undefined symbol is.
+ */
+
+#include "grammar.h"
+#include "random.h"
+#include "emitter.h"
+#include "arena.h"
+#include "profile.h"
+#include <vector>
+using namespace std;
+
+class Expander {
+
+ public:
+
+  /**
+   * Constants: kDefaultMaxDepth, kDefaultMaxLength
+   * ----------------------------------------------
+   * Limits used unless the client asks for others.  Both are far
+   * beyond what any of the sample grammars reach on their own.
+   */
+
+  static const int kDefaultMaxDepth = 1000;
+  static const int kDefaultMaxLength = 100000;
+
+  /**
+   * Constructor: Expander
+   * ---------------------
+   * Constructs an Expander layered over the specified Grammar, which
+   * must outlive it.  Once built, an Expander is read-only and may be
+   * shared between threads.
+   *
+   * @param grammar the compiled grammar being expanded.
+   * @param maxDepth the most productions that may be open at once.
+   * @param maxLength the most terminals a single expansion may produce,
+   *                  unless the shortest possible expansion is longer still.
+   */
+
+  Expander(const Grammar& grammar, int maxDepth = kDefaultMaxDepth, int maxLength = kDefaultMaxLength);
+
+  /**
+   * Method: expand
+   * --------------
+   * Expands the specified symbol and streams each resulting terminal
+   * to out as soon as it's produced.  Productions are picked with the
+   * supplied generator until a limit is reached.  The caller frames the
+   * sentence with out.beginSentence() and out.endSentence().  The
+   * stack lives in the caller's Arena, which the caller resets between
+   * sentences.
+   *
+   * @param symbol the ID of the terminal or nonterminal being expanded.
+   * @param random the generator used to choose productions.
+   * @param out the Emitter the terminals are passed to.
+   * @param scratch the Arena the stack is allocated from.
+   * @param profile the Profile to record the expansion in, or NULL.
+   * @return true if the expansion stayed within both limits without any
+   *         help, and false if shortest productions had to take over.
+   */
+
+  bool expand(int symbol, RandomGenerator& random, Emitter& out, Arena& scratch, Profile *profile = NULL) const;
+
+ private:
+  static const size_t kInitialStackSize = 64;  // frames allocated before the stack first grows
+
+  struct frame {
+    const int *curr;     // next symbol of the open production
+    const int *end;      // one past its last symbol
+    int nonterminal;     // the nonterminal it expands, or -1 for the outermost frame
+    long long produced;  // terminals produced before it opened
+  };
+
+  const Grammar& grammar;
+  int maxDepth;
+  int maxLength;
+  vector<long long> symbolBudgets;      // nonterminal -> terminals it owes if cut short
+  vector<long long> productionBudgets;  // production ID -> sum of its symbols' budgets
+
+  long long getBudget(int symbol) const { return grammar.isNonterminal(symbol) ? symbolBudgets[symbol] : 1; }
+};
+
+#endif // ! __expander__
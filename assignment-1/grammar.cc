@@ -0,0 +1,562 @@
+/**
+ * File: grammar.cc
+ * ----------------
+ * Provides the implementation of the Grammar class, which
+ * flattens the raw text of a grammar file into interned symbol IDs
+ * and contiguous production arrays.
+ */
+
+#include "grammar.h"
+#include <queue>
+#include <algorithm>
+#include <functional>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+const int Grammar::kUnbounded;
+
+/**
+ * Compiled grammar format
+ * -----------------------
+ * A compiledHeader followed by these sections, back to back:
+ *
+ *    int nameOffsets[numSymbols + 1]
+ *    int definitionStarts[numNonterminals + 1]
+ *    int productionStarts[numProductions + 1]
+ *    int symbols[numItems]
+ *    int minLengths[numNonterminals]
+ *    int productionMinLengths[numProductions]
+ *    int shortestProductions[numNonterminals]
+ *    float weights[numProductions]
+ *    uint32_t aliasThresholds[numProductions]
+ *    int aliases[numProductions]
+ *    char namePool[poolSize]
+ *
+ * Everything is in the writer's native byte order; byteOrder lets the
+ * reader notice a file written on a machine of the other endianness.
+ * The header is a multiple of 4 bytes and every section but the last
+ * holds 4-byte values, so every section is suitably aligned inside a mapping.
+ * kCompiledVersion must change whenever the layout does.
+ */
+
+static const char kCompiledMagic[8] = { 'R', 'S', 'G', 'C', 'O', 'M', 'P', '\n' };
+static const uint32_t kCompiledVersion = 2;
+static const uint32_t kByteOrderMark = 0x01020304;
+
+struct compiledHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  int32_t startSymbol;
+  int32_t numSymbols;
+  int32_t numNonterminals;
+  int32_t numProductions;
+  int32_t numItems;
+  int32_t poolSize;
+  int32_t weighted;
+};
+
+/**
+ * Constructor: Grammar
+ * --------------------
+ * Maps the whole file read-only.  A compiled grammar keeps the mapping
+ * for as long as the Grammar lives.  A text grammar is handed to parse
+ * and the mapping is released right away, since every name parse
+ * keeps has been copied into the string pool by then.
+ */
+
+Grammar::Grammar(const char *fileName) :
+  valid(false), weighted(false), startSymbol(-1), numNonterminals(0), nameOffsets(1, 0), definitionStarts(1, 0),
+  productionStarts(1, 0), mapping(NULL), mappingSize(0)
+{
+  bindTables();
+  int fd = open(fileName, O_RDONLY);
+  if (fd == -1) return;
+  struct stat stats;
+  if (fstat(fd, &stats) == -1) {
+    close(fd);
+    return;
+  }
+
+  size_t size = stats.st_size;
+  void *data = NULL;
+  if (size > 0) {
+    data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+      close(fd);
+      return;
+    }
+  }
+  close(fd);  // the mapping stays valid without the descriptor
+
+  if (size >= sizeof(kCompiledMagic) && memcmp(data, kCompiledMagic, sizeof(kCompiledMagic)) == 0) {
+    mapping = data;
+    mappingSize = size;
+    valid = loadCompiled(data, size);
+    return;
+  }
+
+  parse(size > 0 ? (const char *) data : "", size);
+  valid = true;
+  if (data != NULL) munmap(data, size);
+}
+
+Grammar::~Grammar()
+{
+  if (mapping != NULL) munmap(mapping, mappingSize);
+}
+
+/**
+ * Method: bindTables
+ * ------------------
+ * Points the view at the vectors the constructors build, and
+ * derives the table sizes from them.
+ */
+
+void Grammar::bindTables()
+{
+  numSymbols = nameOffsets.size() - 1;
+  numProductions = productionStarts.size() - 1;
+  view.namePool = namePool.data();
+  view.nameOffsets = nameOffsets.data();
+  view.definitionStarts = definitionStarts.data();
+  view.productionStarts = productionStarts.data();
+  view.symbols = symbols.data();
+  view.minLengths = minLengths.data();
+  view.productionMinLengths = productionMinLengths.data();
+  view.shortestProductions = shortestProductions.data();
+  view.weights = weights.data();
+  view.aliasThresholds = aliasThresholds.data();
+  view.aliases = aliases.data();
+}
+
+/**
+ * Method: loadCompiled
+ * --------------------
+ * Checks the header of a mapped compiled grammar and points the view
+ * at its sections.  Besides the header, only the first and last entry
+ * of each table of starts is inspected, so this takes the same time
+ * regardless of the size of the grammar; that's enough to keep a
+ * damaged header from sending any table past the end of its section.
+ */
+
+bool Grammar::loadCompiled(void *data, size_t size)
+{
+  if (size < sizeof(compiledHeader)) return false;
+  const compiledHeader *header = (const compiledHeader *) data;
+  if (header->version != kCompiledVersion || header->byteOrder != kByteOrderMark) return false;
+  if (header->numSymbols < 0 || header->numNonterminals < 0 || header->numProductions < 0 ||
+      header->numItems < 0 || header->poolSize < 0) return false;
+  if (header->numNonterminals > header->numSymbols || header->startSymbol < 0 ||
+      header->startSymbol >= header->numSymbols) return false;
+
+  size_t numInts = (size_t) header->numSymbols + 1 + header->numNonterminals + 1 + header->numProductions + 1 +
+                   header->numItems + header->numNonterminals + header->numProductions + header->numNonterminals +
+                   3 * (size_t) header->numProductions;
+  if (size != sizeof(compiledHeader) + numInts * sizeof(int32_t) + header->poolSize) return false;
+
+  startSymbol = header->startSymbol;
+  numSymbols = header->numSymbols;
+  numNonterminals = header->numNonterminals;
+  numProductions = header->numProductions;
+  weighted = header->weighted != 0;
+
+  const int *section = (const int *) (header + 1);
+  view.nameOffsets = section;               section += numSymbols + 1;
+  view.definitionStarts = section;          section += numNonterminals + 1;
+  view.productionStarts = section;          section += numProductions + 1;
+  view.symbols = section;                   section += header->numItems;
+  view.minLengths = section;                section += numNonterminals;
+  view.productionMinLengths = section;      section += numProductions;
+  view.shortestProductions = section;       section += numNonterminals;
+  view.weights = (const float *) section;   section += numProductions;
+  view.aliasThresholds = (const uint32_t *) section; section += numProductions;
+  view.aliases = section;                   section += numProductions;
+  view.namePool = (const char *) section;
+
+  return view.nameOffsets[0] == 0 && view.nameOffsets[numSymbols] <= header->poolSize &&
+    view.definitionStarts[0] == 0 && view.definitionStarts[numNonterminals] == numProductions &&
+    view.productionStarts[0] == 0 && view.productionStarts[numProductions] == header->numItems;
+}
+
+/**
+ * Method: save
+ * ------------
+ * Writes the header and then each table exactly as the view
+ * presents it, so a mapped Grammar can be saved again as well.
+ */
+
+bool Grammar::save(const char *fileName) const
+{
+  compiledHeader header;
+  memcpy(header.magic, kCompiledMagic, sizeof(kCompiledMagic));
+  header.version = kCompiledVersion;
+  header.byteOrder = kByteOrderMark;
+  header.startSymbol = startSymbol;
+  header.numSymbols = numSymbols;
+  header.numNonterminals = numNonterminals;
+  header.numProductions = numProductions;
+  header.numItems = view.productionStarts[numProductions];
+  header.poolSize = view.nameOffsets[numSymbols];
+  header.weighted = weighted;
+
+  ofstream outfile(fileName, ios::out | ios::binary | ios::trunc);
+  outfile.write((const char *) &header, sizeof(header));
+  outfile.write((const char *) view.nameOffsets, (numSymbols + 1) * sizeof(int));
+  outfile.write((const char *) view.definitionStarts, (numNonterminals + 1) * sizeof(int));
+  outfile.write((const char *) view.productionStarts, (numProductions + 1) * sizeof(int));
+  outfile.write((const char *) view.symbols, header.numItems * sizeof(int));
+  outfile.write((const char *) view.minLengths, numNonterminals * sizeof(int));
+  outfile.write((const char *) view.productionMinLengths, numProductions * sizeof(int));
+  outfile.write((const char *) view.shortestProductions, numNonterminals * sizeof(int));
+  outfile.write((const char *) view.weights, numProductions * sizeof(float));
+  outfile.write((const char *) view.aliasThresholds, numProductions * sizeof(uint32_t));
+  outfile.write((const char *) view.aliases, numProductions * sizeof(int));
+  outfile.write(view.namePool, header.poolSize);
+  outfile.close();
+  return !outfile.fail();
+}
+
+/**
+ * Method: addName
+ * ---------------
+ * Appends the text of the next symbol ID to the string pool.
+ */
+
+void Grammar::addName(const char *text, size_t length)
+{
+  namePool.insert(namePool.end(), text, text + length);
+  namePool.push_back('\0');
+  nameOffsets.push_back(namePool.size());
+}
+
+/**
+ * Class: TokenTable
+ * -----------------
+ * Open-addressing hash table that interns tokens while parse walks
+ * the mapped file.  Tokens are (pointer, length) views into the
+ * mapping, so nothing is copied until the final IDs are known.
+ */
+
+class TokenTable {
+ public:
+  TokenTable() : buckets(1024, -1) {}
+
+  int intern(const char *text, size_t length)
+  {
+    size_t mask = buckets.size() - 1;
+    for (size_t i = hash(text, length) & mask; ; i = (i + 1) & mask) {
+      int id = buckets[i];
+      if (id == -1) break;
+      if (lengths[id] == length && memcmp(starts[id], text, length) == 0) return id;
+    }
+    int id = starts.size();
+    starts.push_back(text);
+    lengths.push_back(length);
+    if (2 * starts.size() > buckets.size()) rehash();
+    else insert(id);
+    return id;
+  }
+
+  int size() const { return starts.size(); }
+  const char *getText(int id) const { return starts[id]; }
+  size_t getLength(int id) const { return lengths[id]; }
+
+  /**
+   * Orders token IDs by their text, the way std::string's operator< would.
+   */
+
+  struct Less {
+    const TokenTable& tokens;
+    Less(const TokenTable& tokens) : tokens(tokens) {}
+    bool operator()(int a, int b) const
+    {
+      size_t length = min(tokens.lengths[a], tokens.lengths[b]);
+      int cmp = memcmp(tokens.starts[a], tokens.starts[b], length);
+      return cmp < 0 || (cmp == 0 && tokens.lengths[a] < tokens.lengths[b]);
+    }
+  };
+
+ private:
+  vector<const char *> starts;
+  vector<size_t> lengths;
+  vector<int> buckets;
+
+  static size_t hash(const char *text, size_t length)
+  {
+    size_t h = 2166136261u;  // FNV-1a
+    for (size_t i = 0; i < length; i++) h = (h ^ (unsigned char) text[i]) * 16777619u;
+    return h;
+  }
+
+  void insert(int id)
+  {
+    size_t mask = buckets.size() - 1;
+    size_t i = hash(starts[id], lengths[id]) & mask;
+    while (buckets[i] != -1) i = (i + 1) & mask;
+    buckets[i] = id;
+  }
+
+  void rehash()
+  {
+    buckets.assign(2 * buckets.size(), -1);
+    for (int id = 0; id < size(); id++) insert(id);
+  }
+};
+
+/**
+ * Function: parseWeight
+ * ---------------------
+ * Decides whether a token terminates a production.  ";" does, with
+ * weight 1, and so does ";" immediately followed by a positive number,
+ * with that number as its weight.  Anything else is an ordinary word.
+ * The number is parsed with strtod from a local copy, since the token
+ * is a pointer into the middle of the mapped file and isn't
+ * '\0'-terminated.
+ */
+
+static bool parseWeight(const char *token, size_t length, double& weight)
+{
+  if (length == 0 || token[0] != ';') return false;
+  if (length == 1) {
+    weight = 1;
+    return true;
+  }
+
+  char number[32];
+  if (length - 1 >= sizeof(number)) return false;
+  memcpy(number, token + 1, length - 1);
+  number[length - 1] = '\0';
+  char *end;
+  double value = strtod(number, &end);
+  if (*end != '\0' || !(value > 0) || value > 1e30) return false;
+  weight = value;
+  return true;
+}
+
+/**
+ * Method: parse
+ * -------------
+ * Tokenizes the grammar text in one pass: everything up to a '{' is commentary, the first token after it
+ * names the nonterminal and the rest of that line is skipped, and
+ * each following line is a production, read as whitespace-separated
+ * tokens up to a standalone ";" with the rest of its line skipped,
+ * until a line starts with '}'.
+ *
+ * Tokens are interned under provisional IDs as they're read.
+ * Afterwards the surviving definitions (the last one for each
+ * nonterminal) are renumbered in sorted order, as if they'd been
+ * collected in a map<string, ...>, and their productions copied out
+ * in the same sequence.
+ */
+
+void Grammar::parse(const char *text, size_t size)
+{
+  TokenTable tokens;
+  vector<int> parsedSymbols;
+  vector<int> parsedStarts(1, 0);  // provisional production -> first index into parsedSymbols
+  vector<float> parsedWeights;     // provisional production -> its weight
+  vector<int> heads;               // parsed definition -> provisional ID of its nonterminal
+  vector<int> firstProductions(1, 0);  // parsed definition -> first provisional production
+
+  const char *curr = text, *end = text + size;
+  while (true) {
+    curr = (const char *) memchr(curr, '{', end - curr);
+    if (curr == NULL) break;
+    curr++;
+    while (curr < end && isspace((unsigned char) *curr)) curr++;
+    const char *token = curr;
+    while (curr < end && !isspace((unsigned char) *curr)) curr++;
+    if (token == curr) break;
+    heads.push_back(tokens.intern(token, curr - token));
+    while (curr < end && *curr++ != '\n') ;
+
+    while (curr < end && *curr != '}') {
+      double weight = 1;
+      while (true) {
+        while (curr < end && isspace((unsigned char) *curr)) curr++;
+        if (curr == end) break;
+        token = curr;
+        while (curr < end && !isspace((unsigned char) *curr)) curr++;
+        if (parseWeight(token, curr - token, weight)) break;
+        parsedSymbols.push_back(tokens.intern(token, curr - token));
+      }
+      parsedStarts.push_back(parsedSymbols.size());
+      parsedWeights.push_back(weight);
+      while (curr < end && *curr++ != '\n') ;
+    }
+    if (curr < end) curr++;  // consume the '}'
+    firstProductions.push_back(parsedStarts.size() - 1);
+  }
+  int start = tokens.intern("<start>", strlen("<start>"));
+
+  vector<int> finalDefinition(tokens.size(), -1);
+  for (size_t def = 0; def < heads.size(); def++)
+    finalDefinition[heads[def]] = def;
+  vector<int> order;
+  for (int token = 0; token < tokens.size(); token++)
+    if (finalDefinition[token] != -1) order.push_back(token);
+  sort(order.begin(), order.end(), TokenTable::Less(tokens));
+  numNonterminals = order.size();
+
+  vector<int> ids(tokens.size(), -1);
+  for (int nt = 0; nt < numNonterminals; nt++)
+    ids[order[nt]] = nt;
+  for (int nt = 0; nt < numNonterminals; nt++) {
+    int def = finalDefinition[order[nt]];
+    for (int prod = firstProductions[def]; prod < firstProductions[def + 1]; prod++) {
+      for (int i = parsedStarts[prod]; i < parsedStarts[prod + 1]; i++) {
+        int token = parsedSymbols[i];
+        if (ids[token] == -1) {
+          ids[token] = order.size();
+          order.push_back(token);
+        }
+        symbols.push_back(ids[token]);
+      }
+      productionStarts.push_back(symbols.size());
+      weights.push_back(parsedWeights[prod]);
+    }
+    definitionStarts.push_back(productionStarts.size() - 1);
+  }
+  if (ids[start] == -1) {
+    ids[start] = order.size();
+    order.push_back(start);
+  }
+  startSymbol = ids[start];
+
+  for (size_t i = 0; i < order.size(); i++)
+    addName(tokens.getText(order[i]), tokens.getLength(order[i]));
+
+  computeMinLengths();
+  computeAliasTables();
+}
+
+/**
+ * Function: addLengths
+ * --------------------
+ * Adds two minimum lengths, saturating at kUnbounded.
+ */
+
+static int addLengths(int a, int b)
+{
+  return (a >= Grammar::kUnbounded - b) ? Grammar::kUnbounded : a + b;
+}
+
+/**
+ * Method: computeMinLengths
+ * -------------------------
+ * Knuth's generalization of Dijkstra's algorithm to grammars.  Every
+ * production keeps the sum of the terminals and settled nonterminals
+ * it contains, plus a count of the nonterminal occurrences still
+ * unsettled.  Once that count reaches zero the production's length is
+ * known and it becomes a candidate for its head.  Heads are settled
+ * in order of increasing length, so a shortest production only ever
+ * mentions nonterminals that were settled strictly before its head,
+ * and following shortest productions can't cycle.
+ */
+
+void Grammar::computeMinLengths()
+{
+  bindTables();
+  vector<int> heads(numProductions);
+  for (int nt = 0; nt < numNonterminals; nt++)
+    for (int p = getFirstProduction(nt); p < getFirstProduction(nt) + getNumProductions(nt); p++)
+      heads[p] = nt;
+
+  vector<int> pending(numProductions, 0);
+  vector<vector<int> > occurrences(numNonterminals);
+  productionMinLengths.assign(numProductions, 0);
+  typedef pair<int, int> candidate;  // (length, production)
+  priority_queue<candidate, vector<candidate>, greater<candidate> > candidates;
+  for (int p = 0; p < numProductions; p++) {
+    for (const int *curr = productionBegin(p); curr != productionEnd(p); ++curr) {
+      if (isNonterminal(*curr)) {
+        pending[p]++;
+        occurrences[*curr].push_back(p);
+      } else {
+        productionMinLengths[p] = addLengths(productionMinLengths[p], 1);
+      }
+    }
+    if (pending[p] == 0) candidates.push(candidate(productionMinLengths[p], p));
+  }
+
+  minLengths.assign(numNonterminals, kUnbounded);
+  shortestProductions.assign(numNonterminals, -1);
+  while (!candidates.empty()) {
+    candidate next = candidates.top();
+    candidates.pop();
+    int head = heads[next.second];
+    if (shortestProductions[head] != -1) continue;  // already settled by a shorter production
+    minLengths[head] = next.first;
+    shortestProductions[head] = next.second;
+    for (size_t i = 0; i < occurrences[head].size(); i++) {
+      int p = occurrences[head][i];
+      productionMinLengths[p] = addLengths(productionMinLengths[p], next.first);
+      if (--pending[p] == 0) candidates.push(candidate(productionMinLengths[p], p));
+    }
+  }
+
+  // productions still waiting on a nonterminal that never settled can't terminate
+  for (int p = 0; p < numProductions; p++)
+    if (pending[p] != 0) productionMinLengths[p] = kUnbounded;
+  bindTables();
+}
+
+/**
+ * Method: computeAliasTables
+ * --------------------------
+ * Builds Vose's alias table for every nonterminal.  Each weight is
+ * scaled so the nonterminal's weights average 1; productions below
+ * average are paired with one above average that donates the rest of
+ * the slot, and whatever is left over at the end (average or numerical
+ * dust) keeps its slot outright.  Grammars whose weights are all 1 skip
+ * the tables entirely, so they consume random numbers exactly as
+ * uniform selection always has.
+ */
+
+void Grammar::computeAliasTables()
+{
+  weighted = false;
+  for (int p = 0; p < numProductions && !weighted; p++)
+    weighted = (weights[p] != 1);
+
+  aliases.resize(numProductions);
+  aliasThresholds.assign(numProductions, UINT32_MAX);
+  for (int p = 0; p < numProductions; p++) aliases[p] = p;
+
+  if (weighted) {
+    vector<double> scaled;
+    vector<int> small, large;
+    for (int nt = 0; nt < numNonterminals; nt++) {
+      int first = definitionStarts[nt], count = definitionStarts[nt + 1] - first;
+      double total = 0;
+      for (int p = first; p < first + count; p++) total += weights[p];
+      scaled.assign(count, 0);
+      small.clear();
+      large.clear();
+      for (int i = 0; i < count; i++) {
+        scaled[i] = weights[first + i] * count / total;
+        (scaled[i] < 1 ? small : large).push_back(i);
+      }
+      while (!small.empty() && !large.empty()) {
+        int less = small.back(), more = large.back();
+        small.pop_back();
+        large.pop_back();
+        aliases[first + less] = first + more;
+        aliasThresholds[first + less] = (uint32_t) min(scaled[less] * 4294967296.0, 4294967295.0);
+        scaled[more] -= 1 - scaled[less];
+        (scaled[more] < 1 ? small : large).push_back(more);
+      }
+    }
+  }
+
+  bindTables();
+}
@@ -0,0 +1,270 @@
+#ifndef __grammar__
+#define __grammar__
+
+/**
+ * File: grammar.h
+ * ---------------
+ * Defines the Grammar class, which is the compiled, read-only
+ * form of a grammar file.  Every terminal and nonterminal
+ * is interned exactly once and is thereafter referred to by a dense
+ * integer ID.  Every production is stored as a run of IDs inside one
+ * flat array, so expanding the grammar never consults a map and never
+ * copies a string.
+ *
+ * Nonterminals are numbered [0, getNumNonterminals()) and terminals
+ * follow them, so deciding whether a symbol needs further expansion
+ * is a single integer comparison.  A bracketed symbol that never
+ * received a definition is treated as a terminal.  The text of every symbol
+ * lives in one '\0'-separated string pool.
+ */
+
+#include "random.h"
+#include <climits>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+using namespace std;
+
+class Grammar {
+
+ public:
+
+  /**
+   * File Constructor: Grammar
+   * -------------------------
+   * Loads the named grammar file, which may be either of two kinds.
+   *
+   * A compiled grammar written by save is mapped and used in place:
+   * every table is read straight out of the mapping, so loading costs
+   * the same no matter how large the grammar is.
+   *
+   * Anything else is taken to be a flat text grammar, which is compiled
+   * in a single pass over a read-only memory map of it, without building
+   * any per-token strings along the way.  Nonterminals are numbered in
+   * sorted order, a nonterminal defined twice keeps its last definition,
+   * and the "<start>" symbol is always interned, even if the grammar
+   * never defines it.
+   *
+   * If the file can't be opened or mapped, or is a compiled grammar
+   * from an incompatible version of rsg, good() returns false.
+   *
+   * @param fileName the path to the grammar file.
+   */
+
+  Grammar(const char *fileName);
+
+  /**
+   * Destructor: ~Grammar
+   * --------------------
+   * Releases the mapping of a compiled grammar file, if there is one.
+   */
+
+  ~Grammar();
+
+  /**
+   * Method: save
+   * ------------
+   * Writes the Grammar to the named file in the compiled format that
+   * the file constructor maps back in.  The format records its version
+   * and the byte order of the machine that wrote it, and files that
+   * don't match the reader are rejected rather than misread.
+   *
+   * @param fileName the path of the file to create or overwrite.
+   * @return true if and only if the whole file was written.
+   */
+
+  bool save(const char *fileName) const;
+
+  /**
+   * Predicate Method: good
+   * ----------------------
+   * Returns true if and only if the Grammar was built without
+   * incident (the file constructor is the only one that can fail).
+   */
+
+  bool good() const { return valid; }
+
+  /**
+   * Method: getStartSymbol
+   * ----------------------
+   * Returns the ID of the "<start>" symbol.
+   */
+
+  int getStartSymbol() const { return startSymbol; }
+
+  /**
+   * Method: isNonterminal
+   * ---------------------
+   * Returns true if and only if the specified symbol has a
+   * definition and therefore needs to be expanded further.
+   */
+
+  bool isNonterminal(int symbol) const { return symbol < numNonterminals; }
+
+  /**
+   * Methods: getSymbolName, getSymbolLength
+   * ---------------------------------------
+   * Return the '\0'-terminated text of the specified symbol, which is
+   * either a terminal word or a nonterminal including its '<' and '>',
+   * and the number of characters in it.
+   */
+
+  const char *getSymbolName(int symbol) const { return view.namePool + view.nameOffsets[symbol]; }
+  int getSymbolLength(int symbol) const { return view.nameOffsets[symbol + 1] - view.nameOffsets[symbol] - 1; }
+
+  /**
+   * Methods: getNumSymbols, getNumNonterminals, getNumProductions
+   * -------------------------------------------------------------
+   * Report the sizes of the interned symbol table and of the
+   * flattened production table.
+   */
+
+  int getNumSymbols() const { return numSymbols; }
+  int getNumNonterminals() const { return numNonterminals; }
+  int getNumProductions() const { return numProductions; }
+
+  /**
+   * Methods: getFirstProduction, getNumProductions
+   * ----------------------------------------------
+   * The productions of a nonterminal occupy a contiguous range of
+   * production IDs, [getFirstProduction(nt), getFirstProduction(nt) +
+   * getNumProductions(nt)), in the order they appeared in the file.
+   */
+
+  int getFirstProduction(int nonterminal) const { return view.definitionStarts[nonterminal]; }
+  int getNumProductions(int nonterminal) const
+    { return view.definitionStarts[nonterminal + 1] - view.definitionStarts[nonterminal]; }
+
+  /**
+   * Methods: productionBegin, productionEnd
+   * ---------------------------------------
+   * Return pointers to the first symbol ID and the past-the-end
+   * symbol ID of the specified production, so a production is
+   * walked with the usual pointer idiom.
+   */
+
+  const int *productionBegin(int production) const { return view.symbols + view.productionStarts[production]; }
+  const int *productionEnd(int production) const { return view.symbols + view.productionStarts[production + 1]; }
+
+  /**
+   * Method: getRandomProduction
+   * ---------------------------
+   * Returns the ID of one of the specified nonterminal's productions,
+   * chosen at random in proportion to the productions' weights (or
+   * uniformly, if the grammar doesn't use weights).  The nonterminal is
+   * assumed to have at least one production.  The caller supplies the
+   * RandomGenerator, so one read-only Grammar can be shared by several
+   * threads as long as each thread brings its own generator.
+   *
+   * Weighted choices use Vose's alias method: pick a production
+   * uniformly, then keep it or switch to its alias with one biased coin
+   * flip, so the cost doesn't depend on how many alternatives there are.
+   *
+   * @param nonterminal the ID of the nonterminal being expanded.
+   * @param random the generator used to make the choice.
+   */
+
+  int getRandomProduction(int nonterminal, RandomGenerator& random) const
+  {
+    int production = random.getRandomInteger(view.definitionStarts[nonterminal], view.definitionStarts[nonterminal + 1] - 1);
+    if (!weighted || view.aliases[production] == production) return production;
+    return ((uint32_t) random.next() < view.aliasThresholds[production]) ? production : view.aliases[production];
+  }
+
+  /**
+   * Methods: isWeighted, getProductionWeight
+   * ----------------------------------------
+   * Report whether any production carries a weight other than 1,
+   * and the weight of the specified production.
+   */
+
+  bool isWeighted() const { return weighted; }
+  double getProductionWeight(int production) const { return view.weights[production]; }
+
+  /**
+   * Constant: kUnbounded
+   * --------------------
+   * The minimum length reported for a nonterminal that can never
+   * finish expanding (every one of its productions recurses forever).
+   */
+
+  static const int kUnbounded = INT_MAX;
+
+  /**
+   * Methods: getMinLength, getMinProductionLength
+   * ---------------------------------------------
+   * Return the fewest terminals that the specified symbol or production
+   * can possibly expand into.  A terminal's minimum length is 1.
+   * Sums that can't terminate (or that overflow) are kUnbounded.
+   */
+
+  int getMinLength(int symbol) const { return isNonterminal(symbol) ? view.minLengths[symbol] : 1; }
+  int getMinProductionLength(int production) const { return view.productionMinLengths[production]; }
+
+  /**
+   * Method: getShortestProduction
+   * -----------------------------
+   * Returns the production that realizes the specified nonterminal's
+   * minimum length, or -1 if the nonterminal can't terminate.  Following
+   * shortest productions alone always terminates: each one only refers
+   * to nonterminals whose own shortest expansions were settled first.
+   */
+
+  int getShortestProduction(int nonterminal) const { return view.shortestProductions[nonterminal]; }
+
+ private:
+  bool valid;
+  bool weighted;
+  int startSymbol;
+  int numSymbols;
+  int numNonterminals;
+  int numProductions;
+
+  // Tables built by the constructors.  They stay empty when the
+  // Grammar is served out of a mapped compiled file.
+  vector<char> namePool;         // every symbol's text, each followed by a '\0'
+  vector<int> nameOffsets;       // symbol ID -> offset of its text in namePool, plus a sentinel
+  vector<int> definitionStarts;  // nonterminal -> first production ID, plus a sentinel
+  vector<int> productionStarts;  // production ID -> first index into symbols, plus a sentinel
+  vector<int> symbols;           // every production's symbol IDs, back to back
+  vector<int> minLengths;           // nonterminal -> fewest terminals it can expand into
+  vector<int> productionMinLengths; // production ID -> fewest terminals it can expand into
+  vector<int> shortestProductions;  // nonterminal -> production realizing minLengths, or -1
+  vector<float> weights;            // production ID -> its weight from the grammar file
+  vector<uint32_t> aliasThresholds; // production ID -> chance (out of 2^32) of keeping it
+  vector<int> aliases;              // production ID -> production chosen instead, or itself
+
+  // What the accessors actually read: either the vectors above
+  // or the corresponding sections of a mapped compiled file.
+  struct tables {
+    const char *namePool;
+    const int *nameOffsets;
+    const int *definitionStarts;
+    const int *productionStarts;
+    const int *symbols;
+    const int *minLengths;
+    const int *productionMinLengths;
+    const int *shortestProductions;
+    const float *weights;
+    const uint32_t *aliasThresholds;
+    const int *aliases;
+  } view;
+
+  void *mapping;
+  size_t mappingSize;
+
+  void addName(const char *text, size_t length);
+  void parse(const char *text, size_t size);
+  bool loadCompiled(void *data, size_t size);
+  void bindTables();
+  void computeMinLengths();
+  void computeAliasTables();
+
+  // marked as private so Grammars can't be copied: the view would
+  // keep pointing into the original's tables or its mapping.
+  Grammar(const Grammar& original);
+  Grammar& operator=(const Grammar& rhs);
+};
+
+#endif // ! __grammar__
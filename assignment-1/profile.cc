@@ -0,0 +1,138 @@
+/**
+ * File: profile.cc
+ * ----------------
+ * Provides the implementation of the Profile class.
+ */
+
+#include "profile.h"
+#include <cstdio>
+#include <algorithm>
+
+Profile::Profile(const Grammar& grammar) :
+  grammar(grammar), expansions(grammar.getNumNonterminals(), 0), forcedExpansions(grammar.getNumNonterminals(), 0),
+  chosen(grammar.getNumProductions(), 0), depthCounts(grammar.getNumNonterminals()),
+  directTerminals(grammar.getNumNonterminals(), 0), totalTerminals(grammar.getNumNonterminals(), 0),
+  terminals(0), sentences(0), seconds(0), fastest(0), slowest(0) {}
+
+void Profile::recordSentence(double elapsed)
+{
+  fastest = (sentences == 0) ? elapsed : min(fastest, elapsed);
+  slowest = max(slowest, elapsed);
+  sentences++;
+  seconds += elapsed;
+
+  size_t bucket = 0;
+  for (double micros = elapsed * 1e6; micros >= 2; micros /= 2) bucket++;
+  if (bucket >= timeCounts.size()) timeCounts.resize(bucket + 1, 0);
+  timeCounts[bucket]++;
+}
+
+/**
+ * Function: add
+ * -------------
+ * Adds one histogram into another, growing it as needed.
+ */
+
+static void add(vector<long long>& into, const vector<long long>& from)
+{
+  if (from.size() > into.size()) into.resize(from.size(), 0);
+  for (size_t i = 0; i < from.size(); i++) into[i] += from[i];
+}
+
+void Profile::merge(const Profile& other)
+{
+  for (int nt = 0; nt < grammar.getNumNonterminals(); nt++) add(depthCounts[nt], other.depthCounts[nt]);
+  add(expansions, other.expansions);
+  add(forcedExpansions, other.forcedExpansions);
+  add(chosen, other.chosen);
+  add(directTerminals, other.directTerminals);
+  add(totalTerminals, other.totalTerminals);
+  add(timeCounts, other.timeCounts);
+  terminals += other.terminals;
+  if (other.sentences > 0) {
+    fastest = (sentences == 0) ? other.fastest : min(fastest, other.fastest);
+    slowest = max(slowest, other.slowest);
+  }
+  sentences += other.sentences;
+  seconds += other.seconds;
+}
+
+/**
+ * Function: writeList
+ * -------------------
+ * Writes a histogram as a JSON array of counts.
+ */
+
+static void writeList(ostream& out, const vector<long long>& counts)
+{
+  out << "[";
+  for (size_t i = 0; i < counts.size(); i++) out << (i == 0 ? "" : ", ") << counts[i];
+  out << "]";
+}
+
+/**
+ * Method: writeJSON
+ * -----------------
+ * Nonterminals are listed in ID order (alphabetical), each production
+ * with its text so the histogram can be read without the grammar file.
+ */
+
+void Profile::writeJSON(ostream& out) const
+{
+  char number[64];
+  out << "{" << endl << "  \"sentences\": {" << endl;
+  out << "    \"count\": " << sentences << "," << endl;
+  out << "    \"terminals\": " << terminals << "," << endl;
+  snprintf(number, sizeof(number), "%.9f", seconds);
+  out << "    \"seconds\": " << number << "," << endl;
+  snprintf(number, sizeof(number), "%.9f", fastest);
+  out << "    \"fastest_seconds\": " << number << "," << endl;
+  snprintf(number, sizeof(number), "%.9f", sentences == 0 ? 0 : seconds / sentences);
+  out << "    \"mean_seconds\": " << number << "," << endl;
+  snprintf(number, sizeof(number), "%.9f", slowest);
+  out << "    \"slowest_seconds\": " << number << "," << endl;
+  out << "    \"microseconds_log2_histogram\": ";
+  writeList(out, timeCounts);
+  out << endl << "  }," << endl << "  \"nonterminals\": [";
+
+  for (int nt = 0; nt < grammar.getNumNonterminals(); nt++) {
+    out << (nt == 0 ? "" : ",") << endl << "    {\"name\": ";
+    writeString(out, grammar.getSymbolName(nt), grammar.getSymbolLength(nt));
+    out << ", \"expansions\": " << expansions[nt] << ", \"forced_shortest\": " << forcedExpansions[nt]
+        << ", \"terminals_direct\": " << directTerminals[nt] << ", \"terminals_total\": " << totalTerminals[nt] << "," << endl;
+    out << "     \"depths\": ";
+    writeList(out, depthCounts[nt]);
+    out << "," << endl << "     \"productions\": [";
+    int first = grammar.getFirstProduction(nt);
+    for (int p = first; p < first + grammar.getNumProductions(nt); p++) {
+      string text;
+      for (const int *curr = grammar.productionBegin(p); curr != grammar.productionEnd(p); ++curr) {
+        if (!text.empty()) text += ' ';
+        text.append(grammar.getSymbolName(*curr), grammar.getSymbolLength(*curr));
+      }
+      out << (p == first ? "" : ",") << endl << "       {\"text\": ";
+      writeString(out, text.data(), text.size());
+      out << ", \"chosen\": " << chosen[p] << "}";
+    }
+    out << "]}";
+  }
+  out << endl << "  ]" << endl << "}" << endl;
+}
+
+void Profile::writeString(ostream& out, const char *text, size_t length)
+{
+  out << '"';
+  for (size_t i = 0; i < length; i++) {
+    unsigned char ch = text[i];
+    if (ch == '"' || ch == '\\') {
+      out << '\\' << ch;
+    } else if (ch < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", ch);
+      out << escape;
+    } else {
+      out << ch;
+    }
+  }
+  out << '"';
+}
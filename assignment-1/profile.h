@@ -0,0 +1,115 @@
+#ifndef __profile__
+#define __profile__
+
+/**
+ * File: profile.h
+ * ---------------
+ * Defines the Profile class, which tallies what expanding a Grammar
+ * actually does, so that it's clear which nonterminals drive the cost
+ * and the size of the output.  For every nonterminal it records
+ *
+ *    - how many times it was expanded, and how often each of its
+ *      productions was the one chosen,
+ *    - how many of those expansions were forced onto the shortest
+ *      production by a depth or length limit,
+ *    - how deep in the derivation each expansion happened, and
+ *    - how many terminals its productions emitted directly, and how
+ *      many its expansions produced in all, nested ones included.
+ *
+ * It also records the wall-clock time of every sentence.  Each worker
+ * thread fills in a Profile of its own, and the results are merged and
+ * written out as JSON once generation is done.
+ */
+
+#include "grammar.h"
+#include <iostream>
+#include <vector>
+using namespace std;
+
+class Profile {
+
+ public:
+
+  /**
+   * Constructor: Profile
+   * --------------------
+   * Constructs an empty Profile of the specified Grammar, which must
+   * outlive it.
+   */
+
+  Profile(const Grammar& grammar);
+
+  /**
+   * Methods: recordExpansion, recordTerminal, recordSubtree
+   * -------------------------------------------------------
+   * Called by the Expander and the Sampler: when a nonterminal is
+   * expanded with a production (at depth open productions deep, and
+   * forced there by a limit or not), when a terminal is emitted by one
+   * of a nonterminal's productions, and when a nonterminal's expansion
+   * finishes having produced the given number of terminals.
+   */
+
+  void recordExpansion(int nonterminal, int production, size_t depth, bool forced)
+  {
+    expansions[nonterminal]++;
+    chosen[production]++;
+    if (forced) forcedExpansions[nonterminal]++;
+    vector<long long>& depths = depthCounts[nonterminal];
+    if (depth >= depths.size()) depths.resize(depth + 1, 0);
+    depths[depth]++;
+  }
+  void recordTerminal(int nonterminal)
+  {
+    terminals++;
+    if (nonterminal != -1) directTerminals[nonterminal]++;
+  }
+  void recordSubtree(int nonterminal, long long length) { totalTerminals[nonterminal] += length; }
+
+  /**
+   * Method: recordSentence
+   * ----------------------
+   * Records the wall-clock time one sentence took.
+   */
+
+  void recordSentence(double seconds);
+
+  /**
+   * Method: merge
+   * -------------
+   * Adds everything recorded by another Profile of the same Grammar.
+   */
+
+  void merge(const Profile& other);
+
+  /**
+   * Method: writeJSON
+   * -----------------
+   * Writes everything recorded as a single JSON object.
+   */
+
+  void writeJSON(ostream& out) const;
+
+  /**
+   * Function: writeString
+   * ---------------------
+   * Writes text as a quoted JSON string, escaping quotes, backslashes
+   * and control characters.
+   */
+
+  static void writeString(ostream& out, const char *text, size_t length);
+
+ private:
+  const Grammar& grammar;
+  vector<long long> expansions;              // nonterminal -> times expanded
+  vector<long long> forcedExpansions;        // nonterminal -> times a limit chose the production
+  vector<long long> chosen;                  // production ID -> times chosen
+  vector<vector<long long> > depthCounts;    // nonterminal -> depth -> expansions at that depth
+  vector<long long> directTerminals;         // nonterminal -> terminals its productions emitted
+  vector<long long> totalTerminals;          // nonterminal -> terminals its expansions produced
+  long long terminals;
+  long long sentences;
+  double seconds, fastest, slowest;
+  vector<long long> timeCounts;              // k -> sentences taking [2^k, 2^(k+1)) microseconds (k = 0 takes faster ones too)
+};
+
+#endif // ! __profile__
@@ -1,13 +1,10 @@
 #include <time.h>
-#include <stdlib.h>
-#include <limits.h>
-#include <cassert> // for assert macro
 #include "random.h"
 
 /**
  * Constructor: RandomGenerator
  * ----------------------------
- * Initializes a RandomGenerator number generator, using 
+ * Initializes a RandomGenerator number generator, using
  * informtaion based on the current time as the seed.
  * This is the traditional way to set the stage for a computer
  * program to use random numbers.
@@ -15,23 +12,58 @@
 
 RandomGenerator::RandomGenerator()
 {
-  srand(time(NULL));
+  seed(time(NULL));
 }
 
 /**
- * Method: getRandomInteger
- * ------------------------
- * Returns a seemingly random number between
- * the specified low and high, inclusive.  Based
- * on Eric Roberts' implementation from his
- * CS106A text.
+ * Constructor: RandomGenerator
+ * ----------------------------
+ * Initializes a RandomGenerator number generator with
+ * an explicit seed.
+ */
+
+RandomGenerator::RandomGenerator(uint64_t seed)
+{
+  this->seed(seed);
+}
+
+/**
+ * Method: seed
+ * ------------
+ * Expands a 64-bit seed into the full 256 bits of state with
+ * splitmix64, as the xoshiro authors recommend.  This also guarantees
+ * the state is never all zeroes, which xoshiro can't recover from.
+ */
+
+void RandomGenerator::seed(uint64_t seed)
+{
+  for (int i = 0; i < 4; i++) {
+    uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    state[i] = z ^ (z >> 31);
+  }
+}
+
+/**
+ * Method: jump
+ * ------------
+ * The standard xoshiro256 jump polynomial: XORs together the states
+ * visited at the positions named by the bits of the jump constants.
  */
 
-int RandomGenerator::getRandomInteger(int low, int high)
+void RandomGenerator::jump()
 {
-  assert(low <= high);
-  double percent = (rand() / (static_cast<double>(RAND_MAX) + 1));
-  assert(percent >= 0.0 && percent < 1.0); 
-  int offset = static_cast<int>(percent * (high - low + 1));
-  return low + offset;
+  static const uint64_t kJump[] = { 0x180ec6d33cfd0abaULL, 0xd5a61266f0c9392cULL,
+                                    0xa9582618e03fc9aaULL, 0x39abdc4529b1661cULL };
+  uint64_t jumped[4] = { 0, 0, 0, 0 };
+  for (int i = 0; i < 4; i++) {
+    for (int b = 0; b < 64; b++) {
+      if (kJump[i] & (1ULL << b)) {
+        for (int j = 0; j < 4; j++) jumped[j] ^= state[j];
+      }
+      next();
+    }
+  }
+  for (int j = 0; j < 4; j++) state[j] = jumped[j];
 }
@@ -6,36 +6,119 @@
  * --------------
  * Provides a random number generator so
  * that pseudo-random numbers can be produced.
+ * The generator is xoshiro256** (Blackman and Vigna):
+ * 256 bits of state per instance, no shared or global
+ * state, and a few shifts and multiplies per number.
  */
 
+#include <stdint.h>
+#include <cassert> // for assert macro
+
 class RandomGenerator {
-  
- public: 
-  
+
+ public:
+
   /**
    * Constructor: RandomGenerator
    * ----------------------------
-   * Constructs a new RandomGenerator object.
+   * Constructs a new RandomGenerator object seeded
+   * from the current time.  Use the seeded constructor
+   * whenever the output needs to be reproducible.
    */
-  
+
   RandomGenerator();
 
+  /**
+   * Constructor: RandomGenerator
+   * ----------------------------
+   * Constructs a new RandomGenerator object with the specified
+   * seed.  Two instances built from the same seed produce exactly
+   * the same sequence of numbers.  Each instance owns its own state,
+   * so several threads may each use their own RandomGenerator
+   * without stepping on one another.
+   *
+   * @param seed the value the instance's stream starts from.
+   */
+
+  RandomGenerator(uint64_t seed);
+
+  /**
+   * Method: next
+   * ------------
+   * Advances the generator and returns the next 64 random bits.
+   */
+
+  uint64_t next()
+  {
+    uint64_t result = rotl(state[1] * 5, 7) * 9;
+    uint64_t t = state[1] << 17;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotl(state[3], 45);
+    return result;
+  }
+
   /**
    * Method: getRandomInteger
    * ------------------------
    * Generates a seemingly random integer between the two specified
    * integers, inclusive.  All numbers in the range [low, high] are
-   * equally likely outcomes.  If low and high are the same, then 
-   * that number is guaranteed to be returned.  If low is greater than
-   * high, then getRandomInteger asserts and ends the program.
+   * equally likely outcomes; there is no modulo bias.  If low and high
+   * are the same, then that number is guaranteed to be returned.  If
+   * low is greater than high, then getRandomInteger asserts and ends
+   * the program.
+   *
+   * Uses Lemire's multiply-and-shift reduction, which needs a division
+   * only in the rare case that a draw has to be rejected.
    *
    * @param the lowest number we'd like to be considered as a return value.
    * @param the highest number we'd like to be considered as a return value.
    * @return some number drawn uniformly from the range [low, high].
    */
-  
-  int getRandomInteger(int low, int high);  
+
+  int getRandomInteger(int low, int high)
+  {
+    assert(low <= high);
+    uint64_t range = (uint64_t) ((int64_t) high - low) + 1;
+    if (range > UINT32_MAX) return (int) (uint32_t) (next() >> 32);  // [INT_MIN, INT_MAX]
+    uint64_t product = (next() >> 32) * range;
+    if ((uint32_t) product < range) {
+      uint32_t threshold = (uint32_t) -range % (uint32_t) range;
+      while ((uint32_t) product < threshold)
+        product = (next() >> 32) * range;
+    }
+    return (int) ((int64_t) low + (int64_t) (product >> 32));
+  }
+
+  /**
+   * Method: getRandomReal
+   * ---------------------
+   * Generates a real number drawn uniformly from [0, 1), using the
+   * top 53 bits of the next draw so that every double in the range
+   * is a multiple of 2^-53.
+   */
+
+  double getRandomReal() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+  /**
+   * Method: jump
+   * ------------
+   * Advances the generator by 2^128 steps in constant time.  Calling
+   * jump on copies of one generator hands out non-overlapping streams,
+   * which is how worker threads get independent yet reproducible
+   * sequences from a single seed.
+   */
+
+  void jump();
+
+ private:
+  uint64_t state[4];
+
+  static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+  void seed(uint64_t seed);
 };
 
 #endif // ! __random__
-
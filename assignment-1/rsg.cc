@@ -2,166 +2,967 @@
  * File: rsg.cc
  * ------------
  * Provides the implementation of the full RSG application, which
- * relies on the services of the built-in string, ifstream, vector,
- * and map classes as well as the custom Production and Definition
- * classes provided with the assignment.
+ * loads a grammar file into a compiled Grammar and prints random
+ * expansions of it using the Expander and Emitter classes.
  */
  
-#include <map>
 #include <string>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <chrono>
 #include <fstream>
-#include "definition.h"
-#include "production.h"
+#include <sstream>
+#include <memory>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+#include <ctime>
+#include <climits>
+#include "grammar.h"
+#include "random.h"
+#include "expander.h"
+#include "emitter.h"
+#include "analyzer.h"
+#include "sampler.h"
+#include "constrained.h"
+#include "cache.h"
+#include "arena.h"
+#include "profile.h"
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 using namespace std;
 
 /**
- * Takes a reference to a legitimate infile (one that's been set up
- * to layer over a file) and populates the grammar map with the
- * collection of definitions that are spelled out in the referenced
- * file.  The function is written under the assumption that the
- * referenced data file is really a grammar file that's properly
- * formatted.  You may assume that all grammars are in fact properly
- * formatted.
+ * Everything a thread needs of its own to generate expansions: a
+ * random stream, an Expander, an Emitter to format into, and an Arena
+ * for the scratch memory of one sentence at a time.  When every
+ * worker should draw uniformly from the derivations of one length
+ * instead, they all share one read-only Sampler, and when every
+ * sentence has to meet a length window or contain a given word, they
+ * share one read-only ConstrainedExpander.  When profiling, each
+ * worker records into a Profile of its own.
+ */
+
+struct Worker {
+  RandomGenerator random;
+  Expander expander;
+  Emitter emitter;
+  const Sampler *sampler;
+  const ConstrainedExpander *constrained;
+  Arena scratch;
+  Profile *profile;
+
+  Worker(const RandomGenerator& random, const Expander& expander, const Emitter& emitter, const Sampler *sampler,
+         const ConstrainedExpander *constrained, Profile *profile = NULL) :
+    random(random), expander(expander), emitter(emitter), sampler(sampler), constrained(constrained),
+    profile(profile) {}
+};
+
+/**
+ * Generates and formats the expansions numbered [first, last) into the
+ * worker's Emitter, each one preceded by its "Version #" banner and
+ * followed by a blank line, unless the Emitter isn't wrapped, in which
+ * case each one is just a line of its own.  Each expansion starts with
+ * <start>.
  *
- * @param infile a valid reference to a flat text file storing the grammar.
- * @param grammar a reference to the STL map, which maps nonterminal strings
- *                to their definitions.
+ * @param first: number of the first expansion (0-based)
+ * @param last: one past the number of the last expansion
+ * @param grammar: const reference to the compiled Grammar
+ * @param worker: reference to the calling thread's Worker
  */
 
-static void readGrammar(ifstream& infile, map<string, Definition>& grammar)
+static void formatExpansions(unsigned int first, unsigned int last, const Grammar& grammar, Worker& worker)
+{
+  char banner[64];
+  for (unsigned int i = first; i != last; ++i) {
+    if (worker.emitter.isWrapped()) {
+      int length = snprintf(banner, sizeof(banner), "Version #%u: -----------------------\n", i + 1);
+      worker.emitter.append(banner, length);
+    }
+    chrono::steady_clock::time_point start;
+    if (worker.profile != NULL) start = chrono::steady_clock::now();
+    worker.emitter.beginSentence();
+    worker.scratch.reset();
+    if (worker.sampler != NULL) {
+      worker.sampler->expand(grammar.getStartSymbol(), worker.random, worker.emitter, worker.scratch, worker.profile);
+    } else if (worker.constrained != NULL) {
+      worker.constrained->expand(grammar.getStartSymbol(), worker.random, worker.emitter, worker.scratch, worker.profile);
+    } else {
+      worker.expander.expand(grammar.getStartSymbol(), worker.random, worker.emitter, worker.scratch, worker.profile);
+    }
+    worker.emitter.endSentence();
+    if (worker.profile != NULL)
+      worker.profile->recordSentence(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    if (worker.emitter.isWrapped()) worker.emitter.append("\n", 1);
+  }
+}
+
+/**
+ * Number of consecutive expansions a worker generates before its
+ * output is handed off.  Large enough that the hand-off cost vanishes,
+ * small enough that output starts flowing right away.
+ */
+
+static const unsigned int kExpansionsPerChunk = 256;
+
+/**
+ * Settings for getNExpansions, filled in from the command line.
+ */
+
+struct BatchOptions {
+  unsigned int count;    // number of expansions to print
+  unsigned int threads;  // number of worker threads
+  bool ordered;          // print the expansions in Version # order
+  uint64_t seed;         // seeds worker 0; worker i's stream starts i jumps further along
+  int maxDepth;          // most productions open at once before shortest productions take over
+  int maxLength;         // most terminals per expansion before shortest productions take over
+  int length;            // exact number of terminals to sample uniformly, or -1 to expand as usual
+  int windowMin;         // fewest terminals per constrained expansion, or -1 for no window
+  int windowMax;         // most terminals per constrained expansion, or -1 for no window
+  const char *include;   // terminal every constrained expansion must contain, or NULL
+  bool plain;            // one expansion per line, with no header line, banners or wrapping
+};
+
+/**
+ * Worker body for unordered batches: repeatedly claims the next chunk
+ * of expansion numbers, formats it privately, and then writes it to
+ * standard output while holding the output lock.  Once any write has
+ * failed, written is false and every worker stops.
+ */
+
+static void expandUnordered(const BatchOptions& options, const Grammar& grammar, Worker& worker,
+                            atomic<unsigned int>& nextChunk, mutex& outputLock, bool& written)
 {
   while (true) {
-    string uselessText;
-    getline(infile, uselessText, '{');
-    if (infile.eof()) return;  // true? we encountered EOF before we saw a '{': no more productions!
-    infile.putback('{');
-    Definition def(infile);
-    grammar[def.getNonterminal()] = def;
+    unsigned int first = nextChunk.fetch_add(kExpansionsPerChunk);
+    if (first >= options.count) return;
+    unsigned int last = min(first + kExpansionsPerChunk, options.count);
+    worker.emitter.clear();
+    formatExpansions(first, last, grammar, worker);
+    lock_guard<mutex> lock(outputLock);
+    if (!written) return;
+    written = Emitter::writeFully(STDOUT_FILENO, worker.emitter.data(), worker.emitter.size());
   }
 }
 
 /**
- * Helper recursive function to expand a given non-terminal into terminals 
- * and append them to a resulting vector of terminals
+ * Prints to terminal n expansions from a given grammar.  All of the
+ * workers share the one read-only Grammar, and each owns its own
+ * Worker.  Every random stream is derived from options.seed, so an
+ * ordered batch prints the same text for the same seed and thread
+ * count no matter how the threads are scheduled.  A single thread
+ * streams straight to standard output.  Ordered batches proceed in
+ * rounds: worker i formats the i-th chunk of the round into its own
+ * Emitter, and the buffers are written back in worker order once
+ * the round is done.  Unordered batches let each worker write its
+ * chunks as soon as they're ready.
  *
- * @param nonterminal: const reference to string denoting a possible non-terminal from a grammar
- * @param grammar: reference to map from string to Definition that stores grammar rules
- * @param terminals: reference to vector of strings that's being populated with terminals from the CFG
+ * @param options: the count, thread count, ordering, seed and limits to use
+ * @param grammar: const reference to the compiled Grammar
+ * @param sampler: the Sampler to draw from, or NULL
+ * @param constrained: the ConstrainedExpander to draw from, or NULL
+ * @param profile: the Profile every worker's records are merged into, or NULL
+ * @return true if all of the output was written; a batch stops at the
+ *         first write that fails
  */
 
-static void expandNonTerminal(const string& nonterminal, map<string, Definition>& grammar, vector<string>& terminals)
+static bool getNExpansions(const BatchOptions& options, const Grammar& grammar, const Sampler *sampler,
+                           const ConstrainedExpander *constrained, Profile *profile)
 {
-  // check if nonterminal is really a non-terminal
-  if (grammar.find(nonterminal) == grammar.end())
-    terminals.push_back(nonterminal);
-  else {
-    Production prod = grammar[nonterminal].getRandomProduction();
-    for (Production::iterator curr = prod.begin(); curr != prod.end(); ++curr)
-      expandNonTerminal(*curr, grammar, terminals);
+  vector<Worker> workerState;
+  vector<Profile> profiles(profile != NULL ? options.threads : 0, Profile(grammar));
+  RandomGenerator random(options.seed);
+  Expander expander(grammar, options.maxDepth, options.maxLength);
+  Emitter emitter(grammar, options.threads == 1 ? STDOUT_FILENO : -1, Emitter::kDefaultCapacity, !options.plain);
+  for (unsigned int i = 0; i != options.threads; ++i) {
+    workerState.push_back(Worker(random, expander, emitter, sampler, constrained, profile != NULL ? &profiles[i] : NULL));
+    random.jump();
+  }
+
+  bool written = true;
+  if (options.threads == 1) {
+    Emitter& emitter = workerState[0].emitter;
+    for (unsigned int first = 0; first < options.count && emitter.good(); ) {
+      unsigned int last = first + min(kExpansionsPerChunk, options.count - first);
+      formatExpansions(first, last, grammar, workerState[0]);
+      first = last;
+    }
+    emitter.flush();
+    written = emitter.good();
+  } else if (!options.ordered) {
+    atomic<unsigned int> nextChunk(0);
+    mutex outputLock;
+    vector<thread> workers;
+    for (unsigned int i = 0; i != options.threads; ++i)
+      workers.push_back(thread(expandUnordered, cref(options), cref(grammar), ref(workerState[i]),
+                               ref(nextChunk), ref(outputLock), ref(written)));
+    for (unsigned int i = 0; i != workers.size(); ++i)
+      workers[i].join();
+  } else {
+    for (unsigned int round = 0; round < options.count && written; round += options.threads * kExpansionsPerChunk) {
+      vector<thread> workers;
+      for (unsigned int i = 0; i != options.threads; ++i) {
+        unsigned int first = min(round + i * kExpansionsPerChunk, options.count);
+        unsigned int last = min(first + kExpansionsPerChunk, options.count);
+        workerState[i].emitter.clear();
+        workers.push_back(thread(formatExpansions, first, last, cref(grammar), ref(workerState[i])));
+      }
+      for (unsigned int i = 0; i != workers.size(); ++i) {
+        workers[i].join();
+        if (written) written = Emitter::writeFully(STDOUT_FILENO, workerState[i].emitter.data(), workerState[i].emitter.size());
+      }
+    }
   }
+
+  for (size_t i = 0; i != profiles.size(); ++i)
+    profile->merge(profiles[i]);
+  return written;
 }
 
 /**
- * Given a valid reference to an STL map storing the grammar (string->Definition), 
- * generates random sequence of terminals in STL's vector.
- * 
- * @param grammar: reference to map from string to Definition that stores grammar rules
- * @param terminals: reference to vector of strings that's being populated with terminals from the CFG
+ * Prints the usage message to cerr.
  */
 
-static void generateTerminals(map<string, Definition>& grammar, vector<string>& terminals)
+static void printUsage()
 {
-  // start with <start>
-  expandNonTerminal(string("<start>"), grammar, terminals);
+  cerr << "Usage: rsg [--count N] [--threads T] [--unordered] [--seed S] [--plain]" << endl
+       << "           [--max-depth D] [--max-length L] [--length N] [--profile <path to JSON file>]" << endl
+       << "           [--window MIN:MAX] [--include WORD] <path to grammar file>" << endl
+       << "       rsg --corpus <directory> --bytes SIZE [--shards K] [--seed S] [--threads T]" << endl
+       << "           [--max-depth D] [--max-length L] [--length N] [--window MIN:MAX] [--include WORD]" << endl
+       << "           <path to grammar file>" << endl
+       << "       rsg --compile <path to grammar text file> [-o <path to compiled grammar>]" << endl
+       << "       rsg --analyze <path to grammar file>" << endl
+       << "       rsg --serve [--socket <path>] [--max-depth D] [--max-length L]" << endl;
 }
 
 /**
- * Given a vector of terminals (strings), pretty-prints it into a terminal
+ * Compiles the named grammar and saves it in the binary format that
+ * rsg can map back in without parsing.  Unless told otherwise, "x.g"
+ * is saved as "x.gc".
  *
- * @param terminals: const ref to vector of strings containing sequence of terminals
+ * @param grammar: const reference to the loaded Grammar
+ * @param grammarFileName: the file the grammar was loaded from
+ * @param outputFileName: the file to save to, or NULL for the default
+ * @return 0 on success, and the usual non-zero code otherwise
  */
 
-static void printTerminals(const vector<string>& terminals)
+static int compileGrammar(const Grammar& grammar, const string& grammarFileName, const char *outputFileName)
 {
-  cout << "     ";
-  unsigned int len = 5, limit = 55;
-  for (vector<string>::const_iterator curr = terminals.begin(); curr != terminals.end(); ++curr) {
-    vector<string>::const_iterator next = curr + 1;
-    if (next != terminals.end() && \
-	*next != "." && *next != "!" && *next != "," && *next != "?" && *next != ";") { 
-      // next terminal is not a punctuation char
-      if (len + 1 + curr->size() > limit) {
-	cout << "\n" << *curr << " ";
-	len = curr->size() + 1;
-      } else {
-	cout << *curr << " ";
-	len = len + (curr->size() + 1);
-      }
+  string output;
+  if (outputFileName != NULL) {
+    output = outputFileName;
+  } else if (grammarFileName.size() > 2 && grammarFileName.compare(grammarFileName.size() - 2, 2, ".g") == 0) {
+    output = grammarFileName + "c";
+  } else {
+    output = grammarFileName + ".gc";
+  }
+
+  if (!grammar.save(output.c_str())) {
+    cerr << "Failed to write the compiled grammar to \"" << output << "\"." << endl;
+    return 4;
+  }
+  cout << "Compiled " << grammar.getNumNonterminals() << " definitions from \"" << grammarFileName
+       << "\" into \"" << output << "\"." << endl;
+  return 0;
+}
+
+/**
+ * Buffer size at which a corpus shard's text is written out.  Large
+ * enough that each write(2) moves a big contiguous run of text.
+ */
+
+static const size_t kCorpusBufferSize = 16 << 20;
+
+/**
+ * One output file of a corpus: sentences only, one per line.  The text
+ * of a shard is exactly what "rsg --plain --seed <seed> --count <sentences>"
+ * prints, given the same limits, so any shard can be regenerated on its own.
+ */
+
+struct Shard {
+  string fileName;
+  uint64_t seed;
+  unsigned long long target;  // write sentences until the shard holds at least this many bytes
+  unsigned int sentences;
+  unsigned long long bytes;
+  bool written;
+};
+
+/**
+ * Generates and writes one shard, formatting sentences into one large
+ * buffer that's handed to the OS whenever it fills.
+ */
+
+static void writeShard(Shard& shard, const BatchOptions& options, const Grammar& grammar, const Sampler *sampler,
+                       const ConstrainedExpander *constrained)
+{
+  shard.sentences = 0;
+  shard.bytes = 0;
+  shard.written = false;
+  int fd = open(shard.fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (fd == -1) return;
+
+  Worker worker(RandomGenerator(shard.seed), Expander(grammar, options.maxDepth, options.maxLength),
+                Emitter(grammar, -1, Emitter::kDefaultCapacity, false), sampler, constrained);
+  bool ok = true;
+  while (ok && shard.bytes + worker.emitter.size() < shard.target) {
+    formatExpansions(shard.sentences, shard.sentences + 1, grammar, worker);
+    shard.sentences++;
+    if (worker.emitter.size() >= kCorpusBufferSize) {
+      ok = Emitter::writeFully(fd, worker.emitter.data(), worker.emitter.size());
+      shard.bytes += worker.emitter.size();
+      worker.emitter.clear();
+    }
+  }
+  ok = ok && Emitter::writeFully(fd, worker.emitter.data(), worker.emitter.size());
+  shard.bytes += worker.emitter.size();
+  shard.written = (close(fd) == 0) && ok;
+}
+
+/**
+ * Worker body for writeCorpus: writes shards until none are left.
+ */
+
+static void writeShards(vector<Shard>& shards, atomic<size_t>& nextShard, const BatchOptions& options,
+                        const Grammar& grammar, const Sampler *sampler, const ConstrainedExpander *constrained)
+{
+  for (size_t i = nextShard++; i < shards.size(); i = nextShard++)
+    writeShard(shards[i], options, grammar, sampler, constrained);
+}
+
+/**
+ * Most worker threads a batch or corpus uses; larger requests are
+ * capped.  Far more than any machine rsg runs on has cores.
+ */
+
+static const unsigned int kMaxThreads = 256;
+
+/**
+ * Parses a whole decimal number in [low, high].
+ *
+ * @return false if text isn't one.
+ */
+
+static bool parseNumber(const char *text, long long low, long long high, long long& value)
+{
+  char *end;
+  errno = 0;
+  long long number = strtoll(text, &end, 10);
+  if (end == text || *end != '\0' || errno == ERANGE || number < low || number > high) return false;
+  value = number;
+  return true;
+}
+
+/**
+ * Parses a byte count such as "4096", "512K", "100M", "10G" or "1T"
+ * (powers of 1024, and an optional trailing B).
+ *
+ * @return false if text isn't a byte count.
+ */
+
+static bool parseSize(const char *text, unsigned long long& bytes)
+{
+  char *end;
+  bytes = strtoull(text, &end, 10);
+  if (end == text || text[0] == '-') return false;
+  const char *units = "KMGT";
+  const char *unit = (*end == '\0') ? NULL : strchr(units, toupper(*end));
+  if (unit != NULL) {
+    for (const char *curr = units; curr <= unit; curr++) bytes *= 1024;
+    end++;
+  }
+  if (*end == 'B' || *end == 'b') end++;
+  return *end == '\0';
+}
+
+/**
+ * Parses a length window such as "20:40" (at least 20 and at most 40
+ * terminals) or "30" (exactly 30).
+ *
+ * @return false if text isn't a window.
+ */
+
+static bool parseWindow(const char *text, int& low, int& high)
+{
+  char *end;
+  long first = strtol(text, &end, 10), second = first;
+  if (end == text || first < 0 || first > INT_MAX) return false;
+  if (*end == ':') {
+    const char *rest = end + 1;
+    second = strtol(rest, &end, 10);
+    if (end == rest || second < first || second > INT_MAX) return false;
+  }
+  if (*end != '\0') return false;
+  low = first;
+  high = second;
+  return true;
+}
+
+/**
+ * Window used when --include is given without --window.  Every
+ * sentence of the sample grammars is far shorter.
+ */
+
+static const int kDefaultWindowMax = 200;
+
+/**
+ * Writes a corpus of about totalBytes of expansions into numShards
+ * files in the named directory (created if need be), with up to
+ * options.threads shards generated in parallel, and then a
+ * manifest.json that lists every shard's file, seed, sentence count
+ * and size.  Shard seeds are drawn from a generator seeded with
+ * options.seed.  The manifest is only written once every shard has
+ * been, and it's written under a temporary name and renamed into
+ * place, so a manifest.json that exists is always complete.
+ *
+ * @return 0 on success, and the usual non-zero code otherwise
+ */
+
+static int writeCorpus(const char *directory, unsigned long long totalBytes, unsigned int numShards,
+                       const BatchOptions& options, const Grammar& grammar, const char *grammarFileName,
+                       const Sampler *sampler, const ConstrainedExpander *constrained)
+{
+  if (mkdir(directory, 0777) != 0 && errno != EEXIST) {
+    cerr << "Failed to create the directory \"" << directory << "\": " << strerror(errno) << endl;
+    return 4;
+  }
+
+  RandomGenerator seeds(options.seed);
+  vector<Shard> shards(numShards);
+  for (unsigned int i = 0; i < numShards; i++) {
+    char fileName[32];
+    snprintf(fileName, sizeof(fileName), "shard-%05u.txt", i);
+    shards[i].fileName = string(directory) + "/" + fileName;
+    shards[i].seed = seeds.next();
+    shards[i].target = totalBytes / numShards + (i < totalBytes % numShards ? 1 : 0);
+  }
+
+  unsigned int numThreads = min(numShards, options.threads);
+  atomic<size_t> nextShard(0);
+  vector<thread> workers;
+  for (unsigned int i = 0; i < numThreads; i++)
+    workers.push_back(thread(writeShards, ref(shards), ref(nextShard), cref(options), cref(grammar), sampler,
+                             constrained));
+  for (size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+
+  string limits;
+  char setting[64];
+  if (sampler != NULL) {
+    snprintf(setting, sizeof(setting), " --length %d", options.length);
+  } else if (constrained != NULL) {
+    snprintf(setting, sizeof(setting), " --window %d:%d", options.windowMin, options.windowMax);
+  } else {
+    snprintf(setting, sizeof(setting), " --max-depth %d --max-length %d", options.maxDepth, options.maxLength);
+  }
+  limits = setting;
+  if (constrained != NULL && options.include != NULL) {
+    limits += " --include '";
+    for (const char *curr = options.include; *curr != '\0'; curr++)
+      limits += (*curr == '\'') ? string("'\\''") : string(1, *curr);
+    limits += "'";
+  }
+
+  unsigned long long written = 0;
+  for (unsigned int i = 0; i < numShards; i++) {
+    if (!shards[i].written) {
+      cerr << "Failed to write \"" << shards[i].fileName << "\"." << endl;
+      return 4;
+    }
+    written += shards[i].bytes;
+  }
+
+  string manifestFileName = string(directory) + "/manifest.json";
+  string temporaryFileName = manifestFileName + ".tmp";
+  ofstream manifest(temporaryFileName.c_str());
+  manifest << "{" << endl << "  \"grammar\": ";
+  Profile::writeString(manifest, grammarFileName, strlen(grammarFileName));
+  manifest << "," << endl << "  \"seed\": " << options.seed << "," << endl
+           << "  \"bytes_requested\": " << totalBytes << "," << endl << "  \"shards\": [";
+  for (unsigned int i = 0; i < numShards; i++) {
+    const Shard& shard = shards[i];
+    string command = "rsg --plain --seed " + to_string(shard.seed) + " --count " + to_string(shard.sentences) + limits +
+                     " " + grammarFileName;
+    manifest << (i == 0 ? "" : ",") << endl << "    {\"file\": ";
+    Profile::writeString(manifest, shard.fileName.c_str() + strlen(directory) + 1, shard.fileName.size() - strlen(directory) - 1);
+    manifest << ", \"seed\": " << shard.seed << ", \"sentences\": " << shard.sentences
+             << ", \"bytes\": " << shard.bytes << "," << endl << "     \"regenerate\": ";
+    Profile::writeString(manifest, command.data(), command.size());
+    manifest << "}";
+  }
+  manifest << endl << "  ]" << endl << "}" << endl;
+  manifest.close();
+  if (!manifest || rename(temporaryFileName.c_str(), manifestFileName.c_str()) != 0) {
+    cerr << "Failed to write \"" << manifestFileName << "\"." << endl;
+    unlink(temporaryFileName.c_str());
+    return 4;
+  }
+
+  cout << "Wrote " << written << " bytes of \"" << grammarFileName << "\" in " << numShards
+       << " shards to \"" << directory << "\"." << endl;
+  return 0;
+}
+
+/**
+ * Number of requests served so far.  It's added to the time to seed
+ * requests that don't supply a seed, so that requests arriving in the
+ * same second still differ.
+ */
+
+static atomic<uint64_t> requestsServed(0);
+
+/**
+ * Limits on a single request to a daemon rsg, so that no one request
+ * can run it out of memory: the most expansions it may ask for, and
+ * the most bytes its reply may hold.  The whole reply is formatted
+ * before its "OK <bytes>" header can be sent, so the second limit
+ * bounds the buffer, and a reply that would cross it is abandoned.
+ */
+
+static const unsigned int kMaxServedCount = 100000;
+static const size_t kMaxReplyBytes = 64 << 20;
+
+/**
+ * What a serving thread keeps from one request to the next: the Worker
+ * it last formatted with, and the grammar and limits it was built for.
+ * Building a Worker means building an Expander's and an Emitter's
+ * per-symbol tables, so consecutive requests for the same grammar and
+ * limits reuse the same one, reseeded, and only a change rebuilds it.
+ * The Emitter's buffer is kept too, so it doesn't have to grow again.
+ */
+
+struct Session {
+  shared_ptr<const Grammar> grammar;
+  int maxDepth;
+  int maxLength;
+  unique_ptr<Worker> worker;
+};
+
+/**
+ * Answers one request of a daemon rsg: a line of whitespace-separated
+ * key=value pairs, as in "grammar=grammars/bond.g count=5 seed=17".
+ * grammar is required, and count, seed, max-depth and max-length
+ * default to the daemon's own settings.  The reply is "OK <bytes>"
+ * and a newline followed by exactly that many bytes of expansions,
+ * formatted just as rsg prints them, or "ERROR <reason>" and a newline.
+ * A count above kMaxServedCount, or a reply that would be longer than
+ * kMaxReplyBytes, is answered with an ERROR.
+ *
+ * @param request: the request line, without its newline
+ * @param defaults: the settings used for anything the request leaves out
+ * @param cache: the cache the grammar is looked up in
+ * @param session: the calling thread's Session
+ * @param fd: where the reply is written
+ * @return false if the reply couldn't be written
+ */
+
+static bool serveRequest(const string& request, const BatchOptions& defaults, GrammarCache& cache, Session& session,
+                         int fd)
+{
+  BatchOptions options = defaults;
+  options.seed = (uint64_t) time(NULL) + requestsServed++;
+  string grammarFileName, error, token;
+  istringstream tokens(request);
+  while (error.empty() && tokens >> token) {
+    size_t equals = token.find('=');
+    string key = token.substr(0, equals);
+    string value = (equals == string::npos) ? "" : token.substr(equals + 1);
+    char *end = NULL;
+    unsigned long long number = strtoull(value.c_str(), &end, 10);
+    bool numeric = !value.empty() && *end == '\0' && value[0] != '-';
+    if (equals == string::npos) {
+      error = "expected key=value, not \"" + token + "\"";
+    } else if (key == "grammar") {
+      grammarFileName = value;
+    } else if (!numeric) {
+      error = "\"" + key + "\" needs a non-negative integer";
+    } else if (key == "count") {
+      if (number > kMaxServedCount) error = "count may be at most " + to_string(kMaxServedCount);
+      options.count = min<unsigned long long>(number, kMaxServedCount);
+    } else if (key == "seed") {
+      options.seed = number;
+    } else if (key == "max-depth") {
+      options.maxDepth = max(1ULL, min<unsigned long long>(number, INT_MAX));
+    } else if (key == "max-length") {
+      options.maxLength = min<unsigned long long>(number, INT_MAX);
     } else {
-      // next terminal is punctuation
-      cout << *curr;
-      len = len + curr->size();
-    }  
-  } 
-  cout << endl;
+      error = "unknown key \"" + key + "\"";
+    }
+  }
+
+  shared_ptr<const Grammar> grammar;
+  if (error.empty() && grammarFileName.empty()) error = "no grammar=";
+  if (error.empty() && !(grammar = cache.get(grammarFileName))) error = "can't load \"" + grammarFileName + "\"";
+
+  if (error.empty()) {
+    if (session.worker == NULL || session.grammar != grammar || session.maxDepth != options.maxDepth ||
+        session.maxLength != options.maxLength) {
+      session.worker.reset();
+      session.grammar = grammar;
+      session.maxDepth = options.maxDepth;
+      session.maxLength = options.maxLength;
+      session.worker.reset(new Worker(RandomGenerator(options.seed), Expander(*grammar, options.maxDepth, options.maxLength),
+                                      Emitter(*grammar), NULL, NULL));
+    } else {
+      session.worker->random = RandomGenerator(options.seed);
+    }
+
+    Worker& worker = *session.worker;
+    worker.emitter.clear();
+    for (unsigned int first = 0; first < options.count && error.empty(); first += kExpansionsPerChunk) {
+      formatExpansions(first, min(first + kExpansionsPerChunk, options.count), *grammar, worker);
+      if (worker.emitter.size() > kMaxReplyBytes) error = "the reply would be over " + to_string(kMaxReplyBytes) + " bytes";
+    }
+  }
+
+  if (!error.empty()) {
+    if (session.worker != NULL) session.worker->emitter.clear();
+    error = "ERROR " + error + "\n";
+    return Emitter::writeFully(fd, error.data(), error.size());
+  }
+
+  Worker& worker = *session.worker;
+  char header[64];
+  int length = snprintf(header, sizeof(header), "OK %zu\n", worker.emitter.size());
+  bool written = Emitter::writeFully(fd, header, length) &&
+                 Emitter::writeFully(fd, worker.emitter.data(), worker.emitter.size());
+  worker.emitter.clear();
+  return written;
+}
+
+/**
+ * Answers every request line read from in, in order, writing the
+ * replies to out, until in runs dry or out is closed.  Blank lines
+ * are skipped.
+ */
+
+static void serveRequests(FILE *in, int out, const BatchOptions& defaults, GrammarCache& cache)
+{
+  char *line = NULL;
+  size_t capacity = 0;
+  ssize_t length;
+  Session session;
+  while ((length = getline(&line, &capacity, in)) != -1) {
+    string request(line, length);
+    if (request.find_first_not_of(" \t\r\n") == string::npos) continue;
+    request.erase(request.find_last_not_of(" \t\r\n") + 1);
+    if (!serveRequest(request, defaults, cache, session, out)) break;
+  }
+  free(line);
+}
+
+/**
+ * Thread body for one client of a daemon listening on a socket.
+ */
+
+static void serveClient(int client, const BatchOptions& defaults, GrammarCache& cache)
+{
+  FILE *in = fdopen(client, "r");
+  if (in == NULL) {
+    close(client);
+    return;
+  }
+  serveRequests(in, client, defaults, cache);
+  fclose(in);
 }
 
 /**
- * Prints to terminal n expansions from a given grammar
+ * Listens on a Unix domain socket at the specified path (replacing
+ * whatever is there) and serves each client that connects on a thread
+ * of its own, all of them sharing one GrammarCache.  Only returns if
+ * the socket can't be set up or stops accepting connections.
  *
- * @param n: number of expansions
- * @param grammar: reference to map from string to Definition that stores grammar rules
+ * @return the usual non-zero code
  */
-static void getNExpansions(const unsigned int n, map<string, Definition>& grammar)
+
+static int serveSocket(const char *path, const BatchOptions& defaults, GrammarCache& cache)
 {
-  for (unsigned int i = 0; i != n; ++i) {
-    cout << "Version #" << i + 1 << ": -----------------------\n";
-    vector<string> result;
-    generateTerminals(grammar, result);
-    printTerminals(result);
-    cout << endl;
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    cerr << "The socket path \"" << path << "\" is too long." << endl;
+    return 7;
+  }
+  strcpy(address.sun_path, path);
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  unlink(path);
+  if (listener == -1 || bind(listener, (sockaddr *) &address, sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+    cerr << "Failed to listen on \"" << path << "\": " << strerror(errno) << endl;
+    return 7;
+  }
+
+  while (true) {
+    int client = accept(listener, NULL, NULL);
+    if (client == -1 && errno == EINTR) continue;
+    if (client == -1) {
+      cerr << "Failed to accept a connection: " << strerror(errno) << endl;
+      close(listener);
+      return 7;
+    }
+    thread(serveClient, client, cref(defaults), ref(cache)).detach();
   }
 }
 
 /**
  * Performs the rudimentary error checking needed to confirm that
  * the client provided a grammar file.  It then continues to
- * open the file, read the grammar into a map<string, Definition>,
- * and then print out the total number of Definitions that were read
- * in.  You're to update and decompose the main function to print
- * three randomly generated sentences, as illustrated by the sample
- * application.
+ * load and compile the grammar straight from the file, and
+ * then print out the total number of Definitions that were read
+ * in, followed by the requested number of randomly generated
+ * sentences (three unless --count says otherwise), or with --plain,
+ * just the sentences, one per line.  With --length,
+ * every sentence is drawn uniformly from all derivations of exactly
+ * that many terminals, and with --window or --include, every sentence
+ * has a length in the window and contains the word, and with --profile, a JSON Profile of the run
+ * is written once it's done.  With --corpus, the sentences go into a
+ * directory of shard files instead, --bytes of them in all.  With --compile it saves the compiled
+ * grammar instead, and with --analyze it prints an Analyzer report
+ * and fails if the grammar wouldn't expand safely.
+ * With --serve it takes no grammar file, and instead answers requests
+ * from standard input, or from clients of a Unix domain socket, until
+ * it's stopped.
  *
  * @param argc the number of tokens making up the command that invoked
- *             the RSG executable.  There must be at least two arguments,
- *             and only the first two are used.
+ *             the RSG executable.  The grammar file is the one argument
+ *             that isn't an option.
  * @param argv the sequence of tokens making up the command, where each
  *             token is represented as a '\0'-terminated C string.
  */
 
 int main(int argc, char *argv[])
 {
-  if (argc == 1) {
+  BatchOptions options = { 3, 1, true, (uint64_t) time(NULL), Expander::kDefaultMaxDepth, Expander::kDefaultMaxLength, -1,
+                           -1, -1, NULL, false };
+  const char *grammarFileName = NULL;
+  const char *outputFileName = NULL;
+  bool compile = false;
+  bool analyze = false;
+  bool serve = false;
+  const char *socketPath = NULL;
+  const char *profileFileName = NULL;
+  const char *corpusDirectory = NULL;
+  unsigned long long corpusBytes = 0;
+  bool corpusBytesGiven = false;
+  unsigned int numShards = 1;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    long long number;
+    if (arg == "--count" && i + 1 < argc) {
+      if (!parseNumber(argv[++i], 0, UINT_MAX, number)) {
+        cerr << "--count needs a number from 0 to " << UINT_MAX << ", not \"" << argv[i] << "\"." << endl;
+        return 3;
+      }
+      options.count = number;
+    } else if (arg == "--threads" && i + 1 < argc) {
+      if (!parseNumber(argv[++i], 1, LLONG_MAX, number)) {
+        cerr << "--threads needs a positive number, not \"" << argv[i] << "\"." << endl;
+        return 3;
+      }
+      options.threads = min<long long>(number, kMaxThreads);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      options.seed = strtoull(argv[++i], NULL, 10);
+    } else if (arg == "--max-depth" && i + 1 < argc) {
+      if (!parseNumber(argv[++i], 1, INT_MAX, number)) {
+        cerr << "--max-depth needs a number from 1 to " << INT_MAX << ", not \"" << argv[i] << "\"." << endl;
+        return 3;
+      }
+      options.maxDepth = number;
+    } else if (arg == "--max-length" && i + 1 < argc) {
+      if (!parseNumber(argv[++i], 0, INT_MAX, number)) {
+        cerr << "--max-length needs a number from 0 to " << INT_MAX << ", not \"" << argv[i] << "\"." << endl;
+        return 3;
+      }
+      options.maxLength = number;
+    } else if (arg == "--length" && i + 1 < argc) {
+      if (!parseNumber(argv[++i], 0, INT_MAX, number)) {
+        cerr << "--length needs a number from 0 to " << INT_MAX << ", not \"" << argv[i] << "\"." << endl;
+        return 3;
+      }
+      options.length = number;
+    } else if (arg == "--window" && i + 1 < argc) {
+      if (!parseWindow(argv[++i], options.windowMin, options.windowMax)) {
+        printUsage();
+        return 3;
+      }
+    } else if (arg == "--include" && i + 1 < argc) {
+      options.include = argv[++i];
+    } else if (arg == "--profile" && i + 1 < argc) {
+      profileFileName = argv[++i];
+    } else if (arg == "--corpus" && i + 1 < argc) {
+      corpusDirectory = argv[++i];
+    } else if (arg == "--bytes" && i + 1 < argc) {
+      corpusBytesGiven = parseSize(argv[++i], corpusBytes);
+      if (!corpusBytesGiven) {
+        printUsage();
+        return 3;
+      }
+    } else if (arg == "--shards" && i + 1 < argc) {
+      numShards = max(1UL, strtoul(argv[++i], NULL, 10));
+    } else if (arg == "--compile") {
+      compile = true;
+    } else if (arg == "--serve") {
+      serve = true;
+    } else if (arg == "--socket" && i + 1 < argc) {
+      serve = true;
+      socketPath = argv[++i];
+    } else if (arg == "--analyze") {
+      analyze = true;
+    } else if (arg == "-o" && i + 1 < argc) {
+      outputFileName = argv[++i];
+    } else if (arg == "--plain") {
+      options.plain = true;
+    } else if (arg == "--ordered") {
+      options.ordered = true;
+    } else if (arg == "--unordered") {
+      options.ordered = false;
+    } else if (arg[0] == '-' || grammarFileName != NULL) {
+      printUsage();
+      return 3;
+    } else {
+      grammarFileName = argv[i];
+    }
+  }
+
+  if (serve) {
+    if (grammarFileName != NULL) {
+      printUsage();
+      return 3;
+    }
+    signal(SIGPIPE, SIG_IGN);  // a client hanging up shouldn't take the daemon down
+    GrammarCache cache;
+    if (socketPath != NULL) return serveSocket(socketPath, options, cache);
+    serveRequests(stdin, STDOUT_FILENO, options, cache);
+    return 0;
+  }
+
+  if (options.length >= 0 && (options.windowMin >= 0 || options.include != NULL)) {
+    cerr << "--length can't be combined with --window or --include." << endl;
+    printUsage();
+    return 3;
+  }
+
+  if (corpusDirectory != NULL && !corpusBytesGiven) {
+    cerr << "A corpus needs a size; use --bytes." << endl;
+    printUsage();
+    return 3;
+  }
+
+  if (grammarFileName == NULL) {
     cerr << "You need to specify the name of a grammar file." << endl;
-    cerr << "Usage: rsg <path to grammar text file>" << endl;
+    printUsage();
     return 1; // non-zero return value means something bad happened 
   }
   
-  ifstream grammarFile(argv[1]);
-  if (grammarFile.fail()) {
-    cerr << "Failed to open the file named \"" << argv[1] << "\".  Check to ensure the file exists. " << endl;
+  Grammar compiled(grammarFileName);
+  if (!compiled.good()) {
+    cerr << "Failed to open the file named \"" << grammarFileName << "\".  Check to ensure the file exists. " << endl;
     return 2; // each bad thing has its own bad return value
   }
   
   // things are looking good...
-  map<string, Definition> grammar;
-  readGrammar(grammarFile, grammar);
-  
-  cout << "The grammar file called \"" << argv[1] << "\" contains "
-       << grammar.size() << " definitions." << endl;
+  if (compile) return compileGrammar(compiled, grammarFileName, outputFileName);
+  if (analyze) {
+    Analyzer analyzer(compiled);
+    analyzer.printReport(cout);
+    return analyzer.isAcceptable() ? 0 : 5;
+  }
 
-  // get 3 expansions
-  getNExpansions(3, grammar);
+  Sampler *sampler = NULL;
+  if (options.length >= 0) {
+    try {
+      sampler = new Sampler(compiled, options.length);
+    } catch (const bad_alloc&) {
+      cerr << "Counting the derivations of " << options.length << " terminals would take more memory than there is." << endl;
+      return 6;
+    }
+    if (!sampler->canSample(compiled.getStartSymbol())) {
+      if (sampler->getCount(compiled.getStartSymbol(), options.length) == 0) {
+        cerr << "The grammar has no sentences of exactly " << options.length << " terminals." << endl;
+      } else {
+        cerr << "The grammar has infinitely many derivations of " << options.length << " terminals "
+             << "(or more than can be counted), so they can't be sampled uniformly." << endl;
+      }
+      delete sampler;
+      return 6;
+    }
+  }
+
+  ConstrainedExpander *constrained = NULL;
+  if (options.windowMin >= 0 || options.include != NULL) {
+    int required = -1;
+    if (options.include != NULL) {
+      for (int symbol = compiled.getNumNonterminals(); symbol < compiled.getNumSymbols(); symbol++)
+        if (strcmp(compiled.getSymbolName(symbol), options.include) == 0) required = symbol;
+      if (required == -1) {
+        cerr << "The word \"" << options.include << "\" never appears in the grammar." << endl;
+        return 6;
+      }
+    }
+    if (options.windowMin < 0) {
+      options.windowMin = 0;
+      options.windowMax = kDefaultWindowMax;
+    }
+    try {
+      constrained = new ConstrainedExpander(compiled, options.windowMin, options.windowMax, required);
+    } catch (const bad_alloc&) {
+      cerr << "A window of up to " << options.windowMax << " terminals would take more memory than there is." << endl;
+      delete sampler;
+      return 6;
+    }
+    if (!constrained->canExpand(compiled.getStartSymbol())) {
+      cerr << "The grammar has no sentences of " << options.windowMin << " to " << options.windowMax << " terminals";
+      if (options.include != NULL) cerr << " containing \"" << options.include << "\"";
+      cerr << "." << endl;
+      delete constrained;
+      return 6;
+    }
+  }
+
+  if (corpusDirectory != NULL) {
+    int result = writeCorpus(corpusDirectory, corpusBytes, numShards, options, compiled, grammarFileName, sampler,
+                             constrained);
+    delete sampler;
+    delete constrained;
+    return result;
+  }
+
+  if (!options.plain)
+    cout << "The grammar file called \"" << grammarFileName << "\" contains "
+         << compiled.getNumNonterminals() << " definitions." << endl;
+
+  Profile *profile = (profileFileName != NULL) ? new Profile(compiled) : NULL;
+  bool written = getNExpansions(options, compiled, sampler, constrained, profile) && cout.good();
+  delete sampler;
+  delete constrained;
+  if (!written) {
+    cerr << "Failed to write the sentences to standard output." << endl;
+    delete profile;
+    return 4;
+  }
+  if (profile != NULL) {
+    ofstream profileFile(profileFileName);
+    profile->writeJSON(profileFile);
+    bool written = profileFile.good();
+    delete profile;
+    if (!written) {
+      cerr << "Failed to write the profile to \"" << profileFileName << "\"." << endl;
+      return 4;
+    }
+  }
   
   return 0;
 }
@@ -0,0 +1,239 @@
+/**
+ * File: sampler.cc
+ * ----------------
+ * Provides the implementation of the Sampler class.
+ */
+
+#include "sampler.h"
+#include "components.h"
+#include <cmath>
+#include <algorithm>
+
+const size_t Sampler::kInitialStackSize;
+
+/**
+ * Function: product
+ * -----------------
+ * Multiplies two counts, treating zero times infinity as zero: no
+ * derivations of one part means no derivations of the whole, however
+ * many the other part has.
+ */
+
+static long double product(long double a, long double b)
+{
+  return (a == 0 || b == 0) ? 0 : a * b;
+}
+
+/**
+ * Constructor: Sampler
+ * --------------------
+ * Fills in the tables one length at a time.  The count of a production
+ * suffix at length n adds up, over every way of splitting n between
+ * its first symbol and the rest, the product of their counts.  Almost
+ * every term uses shorter lengths only, which are already final.  The
+ * exceptions come from symbols that can produce nothing: if every other
+ * symbol of one of <a>'s productions can be empty, <a>'s count at n
+ * needs that symbol's count at n.  Nonterminals are therefore visited
+ * in the order of that "same length" graph, leaves first, and a cycle
+ * in it that has any derivation of length n has infinitely many.
+ * Once every nonterminal's count at n is known, the suffix counts at n
+ * are filled in for good.
+ */
+
+Sampler::Sampler(const Grammar& grammar, int length) :
+  grammar(grammar), length(max(0, length)), width((size_t) this->length + 1), items(grammar.productionBegin(0))
+{
+  int numItems = grammar.productionBegin(grammar.getNumProductions()) - items;
+  suffixMinLengths.resize(numItems);
+  for (int p = 0; p < grammar.getNumProductions(); p++) {
+    long long minLength = 0;
+    for (const int *curr = grammar.productionEnd(p); curr != grammar.productionBegin(p); ) {
+      --curr;
+      minLength = min<long long>(Grammar::kUnbounded, minLength + grammar.getMinLength(*curr));
+      suffixMinLengths[curr - items] = minLength;
+    }
+  }
+
+  vector<vector<int> > successors, components;
+  findSameLengthComponents(grammar, successors, components);
+
+  counts.assign((size_t) grammar.getNumNonterminals() * width, 0);
+  suffixCounts.assign((size_t) numItems * width, 0);
+  for (int n = 0; n <= this->length; n++) {
+    for (size_t c = 0; c < components.size(); c++) {
+      const vector<int>& members = components[c];
+      bool cyclic = isCyclic(members, successors);
+      bool reached = false;
+      for (size_t i = 0; i < members.size(); i++) {
+        int nt = members[i];
+        long double total = 0;
+        for (int p = grammar.getFirstProduction(nt); p < grammar.getFirstProduction(nt) + grammar.getNumProductions(nt); p++)
+          total += countSuffixes(p, n);
+        counts[nt * width + n] = total;
+        if (total > 0) reached = true;
+      }
+      if (cyclic && reached)
+        for (size_t i = 0; i < members.size(); i++) counts[members[i] * width + n] = HUGE_VALL;
+    }
+    for (int p = 0; p < grammar.getNumProductions(); p++)
+      countSuffixes(p, n);
+  }
+}
+
+/**
+ * Method: countSuffixes
+ * ---------------------
+ * Fills in the length n counts of every suffix of the specified
+ * production, last symbol first, and returns the count of the whole
+ * production.  A terminal always takes exactly one, and other splits
+ * are limited to those where each side can reach its share, given the
+ * grammar's minimum lengths.
+ */
+
+long double Sampler::countSuffixes(int production, int n)
+{
+  const int *begin = grammar.productionBegin(production), *end = grammar.productionEnd(production);
+  for (const int *curr = end; curr != begin; ) {
+    --curr;
+    long double total = 0;
+    if (!grammar.isNonterminal(*curr)) {
+      total = (n > 0) ? suffix(curr + 1, end, n - 1) : 0;
+    } else {
+      int high = n - suffixMinLength(curr + 1, end);
+      for (int m = grammar.getMinLength(*curr); m <= high; m++)
+        total += product(count(*curr, m), suffix(curr + 1, end, n - m));
+    }
+    suffixCounts[(curr - items) * width + n] = total;
+  }
+  return suffix(begin, end, n);
+}
+
+long double Sampler::getCount(int symbol, int length) const
+{
+  if (length < 0 || length > this->length) return 0;
+  return count(symbol, length);
+}
+
+bool Sampler::canSample(int symbol) const
+{
+  long double total = count(symbol, length);
+  return total > 0 && total != HUGE_VALL;
+}
+
+/**
+ * Method: expand
+ * --------------
+ * Keeps an explicit stack of open productions, each with the number
+ * of terminals its remaining symbols still have to produce.  The next
+ * symbol's share is chosen in proportion to the derivations each split
+ * allows, and a nonterminal's production in proportion to the
+ * derivations each production allows, so every derivation is equally
+ * likely.  Every count reached this way is finite, since the count it
+ * was drawn from was.
+ */
+
+bool Sampler::expand(int symbol, RandomGenerator& random, Emitter& out, Arena& scratch, Profile *profile) const
+{
+  if (!canSample(symbol)) return false;
+  if (!grammar.isNonterminal(symbol)) {
+    out.emit(symbol);
+    if (profile != NULL) profile->recordTerminal(-1);
+    return true;
+  }
+
+  struct frame {
+    const int *curr;  // next symbol of the open production
+    const int *end;   // one past its last symbol
+    int length;       // terminals the symbols from curr on must produce
+    int nonterminal;  // the nonterminal it expands
+  };
+
+  size_t capacity = kInitialStackSize, depth = 0;
+  frame *stack = scratch.allocate<frame>(capacity);
+  int production = chooseProduction(symbol, length, random);
+  if (profile != NULL) {
+    profile->recordExpansion(symbol, production, 0, false);
+    profile->recordSubtree(symbol, length);
+  }
+  frame root = { grammar.productionBegin(production), grammar.productionEnd(production), length, symbol };
+  stack[depth++] = root;
+  while (depth > 0) {
+    frame& top = stack[depth - 1];
+    if (top.curr == top.end) {
+      depth--;
+      continue;
+    }
+
+    int next = *top.curr;
+    int n = chooseSplit(top.curr, top.end, top.length, random);
+    top.curr++;
+    top.length -= n;
+    if (!grammar.isNonterminal(next)) {
+      out.emit(next);
+      if (profile != NULL) profile->recordTerminal(top.nonterminal);
+      continue;
+    }
+
+    production = chooseProduction(next, n, random);
+    if (profile != NULL) {
+      profile->recordExpansion(next, production, depth, false);
+      profile->recordSubtree(next, n);
+    }
+    frame child = { grammar.productionBegin(production), grammar.productionEnd(production), n, next };
+    if (depth == capacity) stack = scratch.grow(stack, depth, capacity);
+    stack[depth++] = child;
+  }
+  return true;
+}
+
+/**
+ * Method: chooseProduction
+ * ------------------------
+ * Picks one of the nonterminal's productions with probability
+ * proportional to its number of derivations of length n.  If rounding
+ * leaves the draw unclaimed, the last production with any derivations
+ * is used.
+ */
+
+int Sampler::chooseProduction(int nonterminal, int n, RandomGenerator& random) const
+{
+  long double target = random.getRandomReal() * count(nonterminal, n);
+  int chosen = -1;
+  for (int p = grammar.getFirstProduction(nonterminal); p < grammar.getFirstProduction(nonterminal) + grammar.getNumProductions(nonterminal); p++) {
+    long double weight = suffix(grammar.productionBegin(p), grammar.productionEnd(p), n);
+    if (weight == 0) continue;
+    chosen = p;
+    if (target < weight) break;
+    target -= weight;
+  }
+  return chosen;
+}
+
+/**
+ * Method: chooseSplit
+ * -------------------
+ * Picks how many of the n terminals owed from curr on come from the
+ * symbol at curr, with probability proportional to the derivations that
+ * split allows.  Candidates are tried alternately from the smallest
+ * and the largest share, so a split giving m terminals to one side is
+ * found after about 2 * min(m, n - m) tries, which keeps a whole
+ * derivation at O(n log n) work however lopsided its splits are.
+ */
+
+int Sampler::chooseSplit(const int *curr, const int *end, int n, RandomGenerator& random) const
+{
+  if (!grammar.isNonterminal(*curr)) return 1;
+
+  long double target = random.getRandomReal() * suffix(curr, end, n);
+  int low = grammar.getMinLength(*curr), high = n - suffixMinLength(curr + 1, end);
+  int chosen = -1;
+  for (bool fromLow = true; low <= high; fromLow = !fromLow) {
+    int m = fromLow ? low++ : high--;
+    long double weight = product(count(*curr, m), suffix(curr + 1, end, n - m));
+    if (weight == 0) continue;
+    chosen = m;
+    if (target < weight) break;
+    target -= weight;
+  }
+  return chosen;
+}
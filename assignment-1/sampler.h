@@ -0,0 +1,123 @@
+#ifndef __sampler__
+#define __sampler__
+
+/**
+ * File: sampler.h
+ * ---------------
+ * Defines the Sampler class, which draws derivations of a compiled
+ * Grammar uniformly at random from among all derivations producing
+ * exactly a requested number of terminals.  The Expander picks each
+ * production uniformly (or by weight) and so strongly favors short
+ * derivations; the Sampler instead gives every derivation of the
+ * requested length the same chance, and never has to generate and
+ * discard anything to hit that length.
+ *
+ * Construction counts, by dynamic programming, the derivations of
+ * every nonterminal and of every production suffix for every length
+ * up to the requested one.  Sampling then walks the derivation top
+ * down, choosing productions and splitting lengths between symbols in
+ * proportion to those counts.  Production weights play no part here.
+ *
+ * Counts are long doubles, which hold the counts of even very large
+ * grammars at thousands of terminals.  A cycle of productions that
+ * add no terminals (<a> -> <b> -> <a>, or an empty <b> next to <a>)
+ * gives infinitely many derivations of the same sentence, and the
+ * lengths it touches can't be sampled uniformly.
+ */
+
+#include "grammar.h"
+#include "random.h"
+#include "emitter.h"
+#include "arena.h"
+#include "profile.h"
+#include <vector>
+using namespace std;
+
+class Sampler {
+
+ public:
+
+  /**
+   * Constructor: Sampler
+   * --------------------
+   * Counts every derivation of length 0 through length of every
+   * nonterminal of the specified Grammar, which must outlive the
+   * Sampler.  Takes time proportional to the total size of the
+   * productions times length squared, and space proportional to
+   * their size times length.  Once built, a Sampler is read-only and
+   * may be shared between threads.
+   *
+   * @param grammar the compiled grammar being sampled.
+   * @param length the number of terminals every sample has.
+   */
+
+  Sampler(const Grammar& grammar, int length);
+
+  /**
+   * Method: getCount
+   * ----------------
+   * Returns the number of derivations of the specified symbol that
+   * produce exactly length terminals, for any length up to the one
+   * the Sampler was built for.  Infinite counts are HUGE_VALL.
+   */
+
+  long double getCount(int symbol, int length) const;
+
+  /**
+   * Method: canSample
+   * -----------------
+   * Returns true if the specified symbol has a finite, non-zero number
+   * of derivations of the Sampler's length.
+   */
+
+  bool canSample(int symbol) const;
+
+  /**
+   * Method: expand
+   * --------------
+   * Streams to out the terminals of one derivation of the specified
+   * symbol, chosen uniformly among all of its derivations with exactly
+   * the Sampler's length.  Runs in time proportional to the length
+   * times its logarithm.  The caller frames the sentence with
+   * out.beginSentence() and out.endSentence(), and resets the Arena
+   * the stack lives in between sentences.
+   *
+   * @param symbol the ID of the terminal or nonterminal being expanded.
+   * @param random the generator used to make every choice.
+   * @param out the Emitter the terminals are passed to.
+   * @param scratch the Arena the stack is allocated from.
+   * @param profile the Profile to record the derivation in, or NULL.
+   * @return false (having emitted nothing) if canSample(symbol) is false.
+   */
+
+  bool expand(int symbol, RandomGenerator& random, Emitter& out, Arena& scratch, Profile *profile = NULL) const;
+
+ private:
+  static const size_t kInitialStackSize = 64;  // frames allocated before the stack first grows
+
+  const Grammar& grammar;
+  int length;
+  size_t width;                         // length + 1 entries per row
+  const int *items;                     // start of the grammar's production symbols
+  vector<long double> counts;           // nonterminal x length -> derivations
+  vector<long double> suffixCounts;     // item x length -> derivations of the item through the end of its production
+  vector<int> suffixMinLengths;         // item -> fewest terminals from the item through the end of its production
+
+  long double count(int symbol, int n) const
+  {
+    if (!grammar.isNonterminal(symbol)) return n == 1 ? 1 : 0;
+    return counts[symbol * width + n];
+  }
+  long double suffix(const int *curr, const int *end, int n) const
+  {
+    if (curr == end) return n == 0 ? 1 : 0;
+    return suffixCounts[(curr - items) * width + n];
+  }
+  int suffixMinLength(const int *curr, const int *end) const { return curr == end ? 0 : suffixMinLengths[curr - items]; }
+
+  long double countSuffixes(int production, int n);
+  int chooseProduction(int nonterminal, int n, RandomGenerator& random) const;
+  int chooseSplit(const int *curr, const int *end, int n, RandomGenerator& random) const;
+};
+
+#endif // ! __sampler__
@@ -0,0 +1,78 @@
+#include <iostream>
+#include <string>
+#include "imdb.h"
+#include "landmarks.h"
+#include "pathfinder.h"
+using namespace std;
+
+/**
+ * Serves as the main entry point for the imdb-build executable, which
+ * prepares the optional files that speed up every imdb opened on the
+ * same data: the hash indexes that let names and films be found without
+ * binary search (see imdb::writeIndexes), and the co-star file that lets
+ * searches step straight from actor to actor (see imdb::writeCostars),
+ * and the landmarks that bound distances without searching (see
+ * landmarks::write).  They're written into the data directory itself,
+ * where six-degrees looks for them.
+ *
+ * @param argc the number of tokens passed to the command line.
+ * @param argv the C strings making up the full command line.  The one
+ *             argument that isn't an option, if any, names the data
+ *             directory; otherwise the usual one is used.  "--landmarks K"
+ *             asks for K landmarks instead of the default, and 0 skips them,
+ *             and "--threads N" lets each landmark's search use N threads.
+ * @return 0 if every file was written, and 1 otherwise.
+ */
+
+int main(int argc, const char *argv[])
+{
+  const char *directory = NULL;
+  int numLandmarks = landmarks::kDefaultCount;
+  unsigned int threads = 1;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--landmarks" && i + 1 < argc) {
+      if (!landmarks::parseCount(argv[++i], numLandmarks)) {
+        cerr << "--landmarks needs a number from 0 to " << INT_MAX << ", not \"" << argv[i] << "\"." << endl;
+        return 1;
+      }
+    } else if (arg == "--threads" && i + 1 < argc) {
+      if (!pathfinder::parseThreads(argv[++i], threads)) {
+        cerr << "--threads needs a positive number, not \"" << argv[i] << "\"." << endl;
+        return 1;
+      }
+    } else if (directory == NULL && arg.compare(0, 2, "--") != 0) {
+      directory = argv[i];
+    } else {
+      cerr << "Usage: imdb-build [--landmarks K] [--threads N] [data directory]" << endl;
+      return 1;
+    }
+  }
+
+  directory = determinePathToData(directory); // inlined in imdb-utils.h
+  imdb db(directory);
+  if (!db.good()) {
+    cerr << "Failed to properly initialize the imdb database in \"" << directory << "\"." << endl;
+    return 1;
+  }
+
+  if (!db.writeIndexes(directory)) {
+    cerr << "Failed to write the indexes to \"" << directory << "\"." << endl;
+    return 1;
+  }
+  cout << "Wrote the actor and movie indexes to \"" << directory << "\"." << endl;
+
+  if (!db.writeCostars(directory)) {
+    cerr << "Failed to write the co-star file to \"" << directory << "\"." << endl;
+    return 1;
+  }
+  cout << "Wrote the co-star file to \"" << directory << "\"." << endl;
+
+  if (numLandmarks == 0) return 0;
+  if (!landmarks::write(db, directory, numLandmarks, threads)) {
+    cerr << "Failed to write the landmarks to \"" << directory << "\"." << endl;
+    return 1;
+  }
+  cout << "Wrote " << min(numLandmarks, db.getNumActors()) << " landmarks to \"" << directory << "\"." << endl;
+  return 0;
+}
@@ -6,12 +6,19 @@
 #include <string.h>
 #include <cstring>
 #include <iostream>
+#include <fstream>
+#include <algorithm>
 #include "imdb.h"
 
 using namespace std;
 
 const char *const imdb::kActorFileName = "actordata";
 const char *const imdb::kMovieFileName = "moviedata";
+const char *const imdb::kActorIndexFileName = "actorindex";
+const char *const imdb::kMovieIndexFileName = "movieindex";
+const unsigned int imdb::kIndexMagic = 0x58444d49; // "IMDX" when read on a little-endian machine
+const char *const imdb::kCostarFileName = "costars";
+const unsigned int imdb::kCostarMagic = 0x52545343; // "CSTR" when read on a little-endian machine
 
 imdb::imdb(const string& directory)
 {
@@ -19,12 +26,39 @@ imdb::imdb(const string& directory)
   const string movieFileName = directory + "/" + kMovieFileName;
   actorFile = acquireFileMap(actorFileName, actorInfo);
   movieFile = acquireFileMap(movieFileName, movieInfo);
+  actorIndex = loadIndex(directory + "/" + kActorIndexFileName, actorInfo, actorIndexInfo, actorIndexMask);
+  movieIndex = loadIndex(directory + "/" + kMovieIndexFileName, movieInfo, movieIndexInfo, movieIndexMask);
+  if (good()) {
+    buildRanks(actorFile, actorInfo.fileSize, actorRanks);
+    buildRanks(movieFile, movieInfo.fileSize, movieRanks);
+  }
+  loadCostars(directory + "/" + kCostarFileName);
+}
+
+/**
+ * Marks where each record starts, then counts the marks word by word
+ */
+void imdb::buildRanks(const void *file, size_t fileSize, offsetRanks& ranks)
+{
+  size_t num_words = fileSize / 4 / 64 + 1;
+  ranks.starts.assign(num_words, 0);
+  ranks.ranks.assign(num_words, 0);
+  const int *offsets = (const int *) file;
+  for (int i = 0; i < offsets[0]; i++) {
+    unsigned int slot = (unsigned int) offsets[i + 1] / 4;
+    ranks.starts[slot / 64] |= 1ULL << (slot % 64);
+  }
+  int total = 0;
+  for (size_t w = 0; w < num_words; w++) {
+    ranks.ranks[w] = total;
+    total += __builtin_popcountll(ranks.starts[w]);
+  }
 }
 
 bool imdb::good() const
 {
-  return !( (actorInfo.fd == -1) ||
-	    (movieInfo.fd == -1) );
+  return !( (actorInfo.fileMap == NULL) ||
+	    (movieInfo.fileMap == NULL) );
 }
 
 /**
@@ -44,15 +78,54 @@ const void *imdb::getIthMovieRecord(const unsigned int i) const {
     return (void*) &((char*)movieFile)[offset];
 }
 
+/**
+ * FNV-1a over the bytes of the name.
+ */
+unsigned int imdb::hashName(string_view name) {
+    unsigned int hash = 2166136261u;
+    for (size_t i = 0; i != name.size(); ++i)
+      hash = (hash ^ (unsigned char) name[i]) * 16777619u;
+    return hash;
+}
+
+/**
+ * FNV-1a over the bytes of the title, continued over the year byte.
+ */
+unsigned int imdb::hashMovie(string_view title, int year) {
+    return (hashName(title) ^ (unsigned char) (year - 1900)) * 16777619u;
+}
+
+/**
+ * strncmp stops at the record's '\0', so it never reads past the record,
+ * and a record that matches all of name but goes on is the greater one.
+ */
+int imdb::compareName(string_view name, const char *record) {
+    int compare_result = strncmp(name.data(), record, name.size());
+    if (compare_result == 0 && record[name.size()] != '\0')
+      return -1;
+    return compare_result;
+}
+
 /**
  * Returns void pointer to Actor record in question
  * If the actor wasn't found, returns void ptr to actorFile
  */
-const void *imdb::getActorRecord(const char* name) const {
+const void *imdb::getActorRecord(string_view name) const {
+    if (actorIndex != NULL) {
+      unsigned int hash = hashName(name);
+      for (unsigned int i = hash & actorIndexMask; actorIndex[i].record != 0; i = (i + 1) & actorIndexMask) {
+        if (actorIndex[i].hash != hash) continue;
+        const char *current_name = (const char *) getIthActorRecord(actorIndex[i].record - 1);
+        if (compareName(name, current_name) == 0)
+          return current_name;
+      }
+      return actorFile;
+    }
+
     int left = 0, right = *(int*) actorFile - 1, middle = (right + left)/2;
     while (left <= right) {
       char* current_name = (char*) getIthActorRecord(middle);
-      int compare_result = strcmp(name, current_name);
+      int compare_result = compareName(name, current_name);
       if (compare_result == 0)
         return (void*) current_name;
       if (compare_result < 0) {
@@ -68,23 +141,33 @@ const void *imdb::getActorRecord(const char* name) const {
 }
 
 /**
- * Returns void pointer to Actor record in question
- * If the actor wasn't found, returns void ptr to actorFile
+ * Returns void pointer to Movie record in question
+ * If the movie wasn't found, returns void ptr to movieFile
  */
-const void *imdb::getMovieRecord(const film& movie) const {
+const void *imdb::getMovieRecord(string_view title, int year) const {
+    if (movieIndex != NULL) {
+      unsigned int hash = hashMovie(title, year);
+      for (unsigned int i = hash & movieIndexMask; movieIndex[i].record != 0; i = (i + 1) & movieIndexMask) {
+        if (movieIndex[i].hash != hash) continue;
+        const char *curr_movie_ptr = (const char *) getIthMovieRecord(movieIndex[i].record - 1);
+        if (compareName(title, curr_movie_ptr) == 0 && 1900 + curr_movie_ptr[title.size() + 1] == year)
+          return curr_movie_ptr;
+      }
+      return movieFile;
+    }
+
+    // compare in place: strcmp order is exactly string::operator< order
     int left = 0, right = *(int*) movieFile - 1, middle = (right + left)/2;
     while (left <= right) {
-      const void *curr_movie_ptr = getIthMovieRecord(middle);
-      string curr_movie_title((char*) curr_movie_ptr);
-      //cout << curr_movie_title << " - ";
-      int curr_movie_year = 1900 + *((char*) curr_movie_ptr + curr_movie_title.size() + 1);
-      //cout << curr_movie_year << endl;
-      film curr_movie = {curr_movie_title, curr_movie_year};
-      if (curr_movie == movie) {
-        //cout << "Found: " << curr_movie.title << endl;
-        return curr_movie_ptr;
+      const char *curr_movie_ptr = (const char *) getIthMovieRecord(middle);
+      int compare_result = compareName(title, curr_movie_ptr);
+      if (compare_result == 0) {
+        int curr_movie_year = 1900 + curr_movie_ptr[title.size() + 1];
+        if (curr_movie_year == year)
+          return curr_movie_ptr;
+        compare_result = year - curr_movie_year;
       }
-      if (movie < curr_movie) {
+      if (compare_result < 0) {
         right = middle - 1;
         middle = (right + left)/2;
       } else {
@@ -95,47 +178,44 @@ const void *imdb::getMovieRecord(const film& movie) const {
     return movieFile;
 }
 
+/**
+ * Points the view at the actor's record
+ * Returns true if the actor has been found, false otherwise
+ */
+bool imdb::getActor(string_view player, ActorView& actor) const {
+    const char *actor_record = (const char *) getActorRecord(player);
+    if (actor_record == actorFile)
+      return false;
+    actor = ActorView(this, actor_record - (const char *) actorFile);
+    return true;
+}
+
+/**
+ * Points the view at the movie's record
+ * Returns true if the movie has been found, false otherwise
+ */
+bool imdb::getMovie(string_view title, int year, MovieView& movie) const {
+    const char *movie_record = (const char *) getMovieRecord(title, year);
+    if (movie_record == movieFile)
+      return false;
+    movie = MovieView(this, movie_record - (const char *) movieFile);
+    return true;
+}
+
 /**
  * Populates vector of films where a given player acted
  * Returns true if the player has been found, false otherwise
  *
  */
 bool imdb::getCredits(const string& player, vector<film>& films) const {
-    // get a ptr to Actor Record
-    const void *actor_record = getActorRecord(player.c_str());
-
-    // return false if no Actor has been found
-    if (actor_record == actorFile)
+    ActorView actor;
+    if (!getActor(player, actor))
       return false;
 
-    // get to the num of films starred
-    char *ptr = (char*) actor_record;
-
-    // length to check if additional padding is needed after name+num_films
-    short length = 1;
-    while (*ptr++ != '\0')
-      ++length;
-
-    // check for double '\0'
-    if (*ptr == '\0') {
-      ++ptr;
-      ++length;
-    }
-
-    // get num of films, set right after
-    short num_films = *(short*)ptr;
-
-    // set offset depending on whether length + 2 is a multiple of 4
-    int *offset = ((length + 2) % 4 == 0) ? (int*)(((short*)ptr) + 1) : (int*)(((short*)ptr) + 2);
-
-    // iterate over offsets to movieFile, populate vector of films
-    for (short i = 0; i != num_films; ++i, ++offset) {
-      string movie_title(((char*) movieFile) + (*offset));
-      int movie_year = 1900 + *(((char*) movieFile) + (*offset) + movie_title.size() + 1);
-      film tmp = { movie_title, movie_year };
-      films.push_back(tmp);
-    }
-    return true ;
+    CreditsRange credits = actor.getCredits();
+    for (CreditsRange::iterator curr = credits.begin(); curr != credits.end(); ++curr)
+      films.push_back((*curr).getFilm());
+    return true;
 }
 
 /**
@@ -144,34 +224,121 @@ bool imdb::getCredits(const string& player, vector<film>& films) const {
  *
  */
 bool imdb::getCast(const film& movie, vector<string>& players) const {
-  // get a ptr to the movie in question
-  const void *movie_ptr = getMovieRecord(movie);
-
-  // return false if the movie wasn't found
-  if (movie_ptr == movieFile)
+  MovieView view;
+  if (!getMovie(movie.title, movie.year, view))
     return false;
 
-  // get to the array of offsets
-  short offset_to_number_of_actors = movie.title.size() + 2 + (movie.title.size() + 2) % 2;
-  short *ptr = (short*) (((char*) movie_ptr) + offset_to_number_of_actors);
+  CastRange cast = view.getCast();
+  for (CastRange::iterator curr = cast.begin(); curr != cast.end(); ++curr)
+    players.push_back(string((*curr).getName()));
+  return true;
+}
 
-  // check if additional 2 bytes were used for padding
-  int *arr_of_offsets = ((offset_to_number_of_actors + 2) % 4 == 0) ? (int*)(ptr + 1) : (int*) (ptr + 2);
-  short num_actors = *ptr;
+/**
+ * Hashes every record of both files and saves an index for each
+ * Returns true if both were written
+ */
+bool imdb::writeIndexes(const string& directory) const {
+    vector<unsigned int> hashes(*(int*) actorFile);
+    for (unsigned int i = 0; i != hashes.size(); ++i)
+      hashes[i] = hashName(ActorView(this, ((int*) actorFile)[i + 1]).getName());
+    if (!writeIndex(directory + "/" + kActorIndexFileName, hashes, actorInfo.stamp))
+      return false;
 
-  // iterate over the array, populating players vector
-  for (int i = 0; i != num_actors; ++i, ++arr_of_offsets) {
-    string actor_name(((char*) actorFile) + (*arr_of_offsets));
-    players.push_back(actor_name);
-  }
+    hashes.resize(*(int*) movieFile);
+    for (unsigned int i = 0; i != hashes.size(); ++i) {
+      MovieView movie(this, ((int*) movieFile)[i + 1]);
+      hashes[i] = hashMovie(movie.getTitle(), movie.getYear());
+    }
+    return writeIndex(directory + "/" + kMovieIndexFileName, hashes, movieInfo.stamp);
+}
 
-  return true;
+/**
+ * Lays the records out in a table of at least twice as many buckets,
+ * each in the first free bucket at or after its hash, then writes the
+ * header and the table
+ * Returns true if the whole file was written
+ */
+bool imdb::writeIndex(const string& fileName, const vector<unsigned int>& hashes, const fileStamp& dataStamp) {
+    unsigned int num_buckets = 1;
+    while (num_buckets < 2 * hashes.size()) num_buckets *= 2;
+    vector<indexBucket> buckets(num_buckets);
+    for (unsigned int i = 0; i != hashes.size(); ++i) {
+      unsigned int j = hashes[i] & (num_buckets - 1);
+      while (buckets[j].record != 0) j = (j + 1) & (num_buckets - 1);
+      buckets[j].hash = hashes[i];
+      buckets[j].record = i + 1;
+    }
+
+    indexHeader header = { kIndexMagic, (unsigned int) hashes.size(), num_buckets, 0, dataStamp };
+    ofstream out(fileName.c_str(), ios::binary | ios::trunc);
+    out.write((const char *) &header, sizeof(header));
+    out.write((const char *) &buckets[0], buckets.size() * sizeof(indexBucket));
+    out.close();
+    return out.good();
+}
+
+/**
+ * Lists each actor's co-stars by ID, keeping the first movie by ID they
+ * share, encodes them as varints and writes the row out right away, so
+ * only the row starts are kept in memory.  Their room, and the header's,
+ * is skipped at first and filled in last, once every row's start is
+ * known, so a file that was never finished has no valid header
+ * Returns true if the whole file was written
+ */
+bool imdb::writeCostars(const string& directory) const {
+    int num_actors = getNumActors();
+    vector<unsigned long long> starts(num_actors + 1, 0);
+    vector<unsigned char> row;
+    vector<pair<int, int> > links;
+    ofstream out((directory + "/" + kCostarFileName).c_str(), ios::binary | ios::trunc);
+    out.seekp(sizeof(costarHeader) + starts.size() * sizeof(unsigned long long));
+    for (int actor = 0; actor != num_actors && out; ++actor) {
+      links.clear();
+      CreditsRange credits = getActorById(actor).getCredits();
+      for (int c = 0; c != credits.size(); ++c) {
+        int movie = getMovieId(credits.getOffsets()[c]);
+        CastRange cast = credits[c].getCast();
+        for (int k = 0; k != cast.size(); ++k) {
+          int costar = getActorId(cast.getOffsets()[k]);
+          if (costar != actor) links.push_back(make_pair(costar, movie));
+        }
+      }
+      sort(links.begin(), links.end());
+
+      row.clear();
+      int previous = 0;
+      for (unsigned int i = 0; i != links.size(); ++i) {
+        if (i > 0 && links[i].first == links[i - 1].first) continue;
+        unsigned int fields[2] = { (unsigned int) (links[i].first - previous), (unsigned int) links[i].second };
+        for (unsigned int value : fields) {
+          while (value >= 0x80) {
+            row.push_back((unsigned char) (value | 0x80));
+            value >>= 7;
+          }
+          row.push_back((unsigned char) value);
+        }
+        previous = links[i].first;
+      }
+      if (!row.empty()) out.write((const char *) &row[0], row.size());
+      starts[actor + 1] = starts[actor] + row.size();
+    }
+
+    costarHeader header = { kCostarMagic, (unsigned int) num_actors, actorInfo.stamp, movieInfo.stamp };
+    out.seekp(0);
+    out.write((const char *) &header, sizeof(header));
+    out.write((const char *) &starts[0], starts.size() * sizeof(unsigned long long));
+    out.close();
+    return out.good();
 }
 
 imdb::~imdb()
 {
   releaseFileMap(actorInfo);
   releaseFileMap(movieInfo);
+  releaseFileMap(actorIndexInfo);
+  releaseFileMap(movieIndexInfo);
+  releaseFileMap(costarInfo);
 }
 
 // ignore everything below... it's all UNIXy stuff in place to make a file look like
@@ -179,13 +346,69 @@ imdb::~imdb()
 const void *imdb::acquireFileMap(const string& fileName, struct fileInfo& info)
 {
   struct stat stats;
-  stat(fileName.c_str(), &stats);
-  info.fileSize = stats.st_size;
+  info.fileSize = 0;
+  info.fileMap = NULL;
+  info.stamp = fileStamp();
   info.fd = open(fileName.c_str(), O_RDONLY);
+  if (info.fd == -1 || fstat(info.fd, &stats) != 0) return NULL;
+  info.fileSize = stats.st_size;
+  info.stamp.size = stats.st_size;
+  info.stamp.inode = stats.st_ino;
+  info.stamp.modifiedSeconds = stats.st_mtim.tv_sec;
+  info.stamp.modifiedNanoseconds = stats.st_mtim.tv_nsec;
   info.fileMap = mmap(0, info.fileSize, PROT_READ, MAP_SHARED, info.fd, 0);
+  if (info.fileMap == MAP_FAILED) info.fileMap = NULL;
   return info.fileMap;
 }
 
+// an index is only used if it was built from this very data file, as
+// of its last modification; anything else is left unmapped and ignored
+const imdb::indexBucket *imdb::loadIndex(const string& fileName, const struct fileInfo& data,
+                                         struct fileInfo& info, unsigned int& mask)
+{
+  const indexHeader *header = (const indexHeader *) acquireFileMap(fileName, info);
+  bool usable = header != NULL && data.fileMap != NULL && info.fileSize >= sizeof(indexHeader) &&
+    header->magic == kIndexMagic && header->numRecords == *(const unsigned int *) data.fileMap &&
+    header->dataStamp == data.stamp && header->numBuckets != 0 &&
+    (header->numBuckets & (header->numBuckets - 1)) == 0 && header->numBuckets > header->numRecords &&
+    info.fileSize == sizeof(indexHeader) + header->numBuckets * sizeof(indexBucket);
+  if (!usable) {
+    releaseFileMap(info);
+    info.fd = -1;
+    info.fileMap = NULL;
+    return NULL;
+  }
+  mask = header->numBuckets - 1;
+  return (const indexBucket *) (header + 1);
+}
+
+// the co-star file is held to the same standard: it has to have been
+// built from these very data files, and its positions have to add up
+void imdb::loadCostars(const string& fileName)
+{
+  costarStarts = NULL;
+  costarData = NULL;
+  const costarHeader *header = (const costarHeader *) acquireFileMap(fileName, costarInfo);
+  if (!good()) header = NULL;
+  size_t prefix = 0;
+  const unsigned long long *starts = NULL;
+  if (header != NULL && costarInfo.fileSize >= sizeof(costarHeader) && header->magic == kCostarMagic &&
+      header->numActors == *(const unsigned int *) actorFile &&
+      header->actorStamp == actorInfo.stamp && header->movieStamp == movieInfo.stamp) {
+    prefix = sizeof(costarHeader) + (header->numActors + 1) * sizeof(unsigned long long);
+    starts = (const unsigned long long *) (header + 1);
+  }
+  if (starts == NULL || costarInfo.fileSize < prefix || starts[0] != 0 ||
+      starts[header->numActors] != costarInfo.fileSize - prefix) {
+    releaseFileMap(costarInfo);
+    costarInfo.fd = -1;
+    costarInfo.fileMap = NULL;
+    return;
+  }
+  costarStarts = starts;
+  costarData = (const unsigned char *) costarInfo.fileMap + prefix;
+}
+
 void imdb::releaseFileMap(struct fileInfo& info)
 {
   if (info.fileMap != NULL) munmap((char *) info.fileMap, info.fileSize);
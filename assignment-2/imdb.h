@@ -3,9 +3,210 @@
 
 #include "imdb-utils.h"
 #include <string>
+#include <string_view>
 #include <vector>
+#include <cstring>
+#include <cstddef>
 using namespace std;
 
+class imdb;
+
+/**
+ * Class Template: RecordRange
+ * ---------------------------
+ * A read-only range over one of the arrays of offsets stored in the data
+ * files: an actor's credits, or a movie's cast.  Iterating over it yields
+ * a View (an ActorView or a MovieView) for each record the offsets lead
+ * to, built on the spot.  Nothing is copied and nothing is allocated,
+ * and the range stays valid for as long as the imdb it came from.
+ */
+
+template <typename View>
+class RecordRange {
+
+ public:
+  class iterator {
+   public:
+    iterator() : offset(NULL), db(NULL) {}
+    iterator(const int *offset, const imdb *db) : offset(offset), db(db) {}
+    View operator*() const { return View(db, *offset); }
+    iterator& operator++() { ++offset; return *this; }
+    iterator operator++(int) { iterator old = *this; ++offset; return old; }
+    bool operator==(const iterator& rhs) const { return offset == rhs.offset; }
+    bool operator!=(const iterator& rhs) const { return offset != rhs.offset; }
+
+   private:
+    const int *offset;
+    const imdb *db;
+  };
+
+  RecordRange() : first(NULL), count(0), db(NULL) {}
+  RecordRange(const int *first, int count, const imdb *db) : first(first), count(count), db(db) {}
+
+  iterator begin() const { return iterator(first, db); }
+  iterator end() const { return iterator(first + count, db); }
+  int size() const { return count; }
+  bool empty() const { return count == 0; }
+  View operator[](int i) const { return View(db, first[i]); }
+
+  /**
+   * Method: getOffsets
+   * ------------------
+   * Exposes the raw offsets themselves, each of which identifies one record
+   * of the other file (see getOffset on the views).
+   */
+
+  const int *getOffsets() const { return first; }
+
+ private:
+  const int *first;
+  int count;
+  const imdb *db;
+};
+
+class ActorView;
+class MovieView;
+typedef RecordRange<MovieView> CreditsRange;
+typedef RecordRange<ActorView> CastRange;
+
+/**
+ * Classes: ActorView, MovieView
+ * -----------------------------
+ * Lightweight handles on one actor's or one movie's record in the mapped
+ * data files.  Names and titles come back as string_views into the files
+ * themselves, and credits and casts as RecordRanges over the records'
+ * own offset arrays, so a graph search can walk millions of records
+ * without copying a single string.  A view is the size of two pointers,
+ * is meant to be passed by value, and stays valid for as long as its
+ * imdb.  A default-constructed view refers to no record at all.
+ *
+ * getOffset returns where the record starts in its file, which is what
+ * the other file's offset arrays store, so it identifies the record.
+ * getId returns the record's dense integer ID instead: its position in
+ * its file's offset table, from 0 up to the number of actors (or movies),
+ * which makes it a direct subscript into arrays and bitsets.
+ */
+
+class ActorView {
+
+ public:
+  ActorView() : db(NULL), record(NULL) {}
+  ActorView(const imdb *db, int offset);
+
+  string_view getName() const { return string_view(record); }
+  CreditsRange getCredits() const;
+  int getOffset() const;
+  int getId() const;
+  bool operator==(const ActorView& rhs) const { return record == rhs.record; }
+  bool operator!=(const ActorView& rhs) const { return record != rhs.record; }
+
+ private:
+  const imdb *db;
+  const char *record;
+};
+
+class MovieView {
+
+ public:
+  MovieView() : db(NULL), record(NULL) {}
+  MovieView(const imdb *db, int offset);
+
+  string_view getTitle() const { return string_view(record); }
+  int getYear() const { return 1900 + record[strlen(record) + 1]; }
+  CastRange getCast() const;
+  int getOffset() const;
+  int getId() const;
+  bool operator==(const MovieView& rhs) const { return record == rhs.record; }
+  bool operator!=(const MovieView& rhs) const { return record != rhs.record; }
+
+  /**
+   * Method: getFilm
+   * ---------------
+   * Copies the title and year into a film, for printing or for
+   * comparison with films from elsewhere.
+   */
+
+  film getFilm() const { film movie = { string(getTitle()), getYear() }; return movie; }
+
+ private:
+  const imdb *db;
+  const char *record;
+};
+
+/**
+ * Class: CostarRange
+ * ------------------
+ * A read-only range over one actor's co-stars, as stored in the optional
+ * co-star file (see imdb::writeCostars).  Iterating over it yields a
+ * costarLink for every other actor or actress who shares a movie with
+ * the first one: the co-star's ID and the ID of one movie they share,
+ * in increasing order of co-star ID.
+ *
+ * Each link is stored as two unsigned varints (seven bits to a byte,
+ * least significant first, with the top bit set on every byte but the
+ * last): how far the co-star's ID is past the previous one's, and the
+ * movie's ID.  Iteration decodes them as it goes, so, like a
+ * RecordRange, the range copies and allocates nothing.
+ */
+
+struct costarLink {
+  int actor;             // ID of the co-star
+  int movie;             // ID of a movie the two of them share
+};
+
+class CostarRange {
+
+ public:
+  class iterator {
+   public:
+    iterator() : curr(NULL), next(NULL), end(NULL) {}
+    iterator(const unsigned char *curr, const unsigned char *end) : curr(curr), next(curr), end(end)
+    {
+      link.actor = 0;
+      decode();
+    }
+    const costarLink& operator*() const { return link; }
+    const costarLink *operator->() const { return &link; }
+    iterator& operator++() { curr = next; decode(); return *this; }
+    bool operator==(const iterator& rhs) const { return curr == rhs.curr; }
+    bool operator!=(const iterator& rhs) const { return curr != rhs.curr; }
+
+   private:
+    const unsigned char *curr;  // start of the current link
+    const unsigned char *next;  // start of the link after it
+    const unsigned char *end;   // one past the last link
+    costarLink link;            // the current link, decoded
+
+    void decode()
+    {
+      if (next == end) return;
+      link.actor += readVarint(next);
+      link.movie = readVarint(next);
+    }
+
+    static int readVarint(const unsigned char *& p)
+    {
+      unsigned int value = 0;
+      for (int shift = 0; ; shift += 7) {
+        unsigned char byte = *p++;
+        value |= (unsigned int) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) return value;
+      }
+    }
+  };
+
+  CostarRange() : first(NULL), last(NULL) {}
+  CostarRange(const unsigned char *first, const unsigned char *last) : first(first), last(last) {}
+
+  iterator begin() const { return iterator(first, last); }
+  iterator end() const { return iterator(last, last); }
+  bool empty() const { return first == last; }
+
+ private:
+  const unsigned char *first;
+  const unsigned char *last;
+};
+
 class imdb {
 
  public:
@@ -37,6 +238,73 @@ class imdb {
 
   bool good() const;
 
+  /**
+   * Predicate Method: hasIndexes
+   * ----------------------------
+   * Returns true if and only if up-to-date hash indexes were found next to
+   * both data files (see writeIndexes), in which case every name and film
+   * lookup costs one hash and, almost always, a single comparison.  Without
+   * them, lookups fall back on binary search, which gives the same answers.
+   */
+
+  bool hasIndexes() const { return actorIndex != NULL && movieIndex != NULL; }
+
+  /**
+   * Method: writeIndexes
+   * --------------------
+   * Builds a hash index over each of the two data files and saves them
+   * in the specified directory (typically the one the imdb was opened from),
+   * as "actorindex" and "movieindex".  Each index maps an actor's name, or
+   * a film's title and year, to the number of its record.  An index
+   * remembers how many records and bytes its data file had, so one that's
+   * gone stale is ignored rather than trusted.
+   *
+   * @param directory the name of the directory the indexes are written to.
+   * @return true if and only if both indexes were written in full.
+   */
+
+  bool writeIndexes(const string& directory) const;
+
+  /**
+   * Predicate Method: hasCostars
+   * ----------------------------
+   * Returns true if and only if an up-to-date co-star file was found next
+   * to the data files (see writeCostars), so that getCostars can be used.
+   */
+
+  bool hasCostars() const { return costarStarts != NULL; }
+
+  /**
+   * Method: getCostars
+   * ------------------
+   * Returns the co-stars of the actor or actress with the specified ID,
+   * each with a movie they share, straight from the co-star file.  That's
+   * one step from actor to actor, where going through getCredits and
+   * getCast takes two and visits every co-star once per shared movie.
+   * Only to be called if hasCostars() is true.
+   */
+
+  CostarRange getCostars(int actorId) const
+  {
+    return CostarRange(costarData + costarStarts[actorId], costarData + costarStarts[actorId + 1]);
+  }
+
+  /**
+   * Method: writeCostars
+   * --------------------
+   * Derives the actor-to-actor graph from the two data files and saves it
+   * in the specified directory as "costars": for each actor, in order of
+   * ID, the list of co-stars a CostarRange reads, and in front of the
+   * lists the position where each one starts (a compressed sparse row
+   * layout).  Like an index, the file remembers the sizes of the data
+   * files it was built from, and is ignored once they've changed.
+   *
+   * @param directory the name of the directory the file is written to.
+   * @return true if and only if the file was written in full.
+   */
+
+  bool writeCostars(const string& directory) const;
+
   /**
    * Method: getCredits
    * ------------------
@@ -74,6 +342,74 @@ class imdb {
 
   bool getCast(const film& movie, vector<string>& players) const;
 
+  /**
+   * Methods: getActor, getMovie
+   * ---------------------------
+   * Find the specified actor/actress, or the specified film, and set the
+   * view to refer to its record, from which the name, the credits or
+   * the cast can be read without copying anything (see ActorView and
+   * MovieView).  If there's no such record, the view is left unchanged.
+   *
+   * @return true if and only if the record was found.
+   */
+
+  bool getActor(string_view player, ActorView& actor) const;
+  bool getMovie(string_view title, int year, MovieView& movie) const;
+
+  /**
+   * Methods: getNumActors, getNumMovies, getActorById, getMovieById
+   * ---------------------------------------------------------------
+   * Every record has a dense integer ID (see ActorView::getId), from 0 to
+   * getNumActors() - 1 or getNumMovies() - 1, and can be viewed by ID.
+   * Searches over the whole database keep their state in arrays indexed
+   * by these IDs and only go back to names to print their answers.
+   */
+
+  int getNumActors() const { return *(const int *) actorFile; }
+  int getNumMovies() const { return *(const int *) movieFile; }
+  ActorView getActorById(int id) const { return ActorView(this, ((const int *) actorFile)[id + 1]); }
+  MovieView getMovieById(int id) const { return MovieView(this, ((const int *) movieFile)[id + 1]); }
+
+  /**
+   * Methods: getActorId, getMovieId
+   * -------------------------------
+   * Convert a record's offset, as found in a credits or cast array, straight
+   * to its ID, in constant time.
+   */
+
+  int getActorId(int offset) const { return getRank(actorRanks, offset); }
+  int getMovieId(int offset) const { return getRank(movieRanks, offset); }
+
+  /**
+   * Struct: fileStamp
+   * -----------------
+   * A data file's size, inode and modification time as of when it was
+   * mapped.  Files derived from the data record the stamps of the files
+   * they were built from and are ignored once those change, since a data
+   * file can be rewritten in place without changing its size.
+   */
+
+  struct fileStamp {
+    unsigned long long size;
+    unsigned long long inode;
+    long long modifiedSeconds;
+    long long modifiedNanoseconds;
+
+    bool operator==(const fileStamp& other) const {
+      return size == other.size && inode == other.inode && modifiedSeconds == other.modifiedSeconds &&
+        modifiedNanoseconds == other.modifiedNanoseconds;
+    }
+  };
+
+  /**
+   * Methods: getActorStamp, getMovieStamp
+   * -------------------------------------
+   * Return the stamps of the two data files.
+   */
+
+  const fileStamp& getActorStamp() const { return actorInfo.stamp; }
+  const fileStamp& getMovieStamp() const { return movieInfo.stamp; }
+
   /**
    * Destructor: ~imdb
    * -----------------
@@ -86,9 +422,55 @@ class imdb {
  private:
   static const char *const kActorFileName;
   static const char *const kMovieFileName;
+  static const char *const kActorIndexFileName;
+  static const char *const kMovieIndexFileName;
+  static const unsigned int kIndexMagic;
+  static const char *const kCostarFileName;
+  static const unsigned int kCostarMagic;
   const void *actorFile;
   const void *movieFile;
 
+  /**
+   * Layout of an index file: this header, then numBuckets buckets
+   * forming an open-addressing hash table with linear probing, at most
+   * half full.  Each bucket holds the full hash of its record's key, so
+   * a probe only compares strings when the hashes already match.
+   */
+
+  struct indexHeader {
+    unsigned int magic;         // kIndexMagic, which also rules out files of the other byte order
+    unsigned int numRecords;    // number of records in the data file
+    unsigned int numBuckets;    // a power of two
+    unsigned int unused;        // always 0, so the stamp is aligned without padding
+    fileStamp dataStamp;        // stamp of the data file it was built from
+  };
+
+  struct indexBucket {
+    unsigned int hash;          // hash of the record's key
+    unsigned int record;        // record number plus one, or 0 if the bucket is empty
+  };
+
+  const indexBucket *actorIndex;  // NULL unless an up-to-date actor index was found
+  const indexBucket *movieIndex;  // NULL unless an up-to-date movie index was found
+  unsigned int actorIndexMask;
+  unsigned int movieIndexMask;
+
+  /**
+   * Layout of the co-star file: this header, then numActors + 1 positions,
+   * where actor i's links start and end relative to the first byte after
+   * them, then the links themselves (see CostarRange).
+   */
+
+  struct costarHeader {
+    unsigned int magic;         // kCostarMagic, which also rules out files of the other byte order
+    unsigned int numActors;     // number of records in the actor file
+    fileStamp actorStamp;       // stamp of the actor file it was built from
+    fileStamp movieStamp;       // stamp of the movie file it was built from
+  };
+
+  const unsigned long long *costarStarts;  // NULL unless an up-to-date co-star file was found
+  const unsigned char *costarData;
+
   /**
    * Method: getIthActorRecord
    * ------------------------
@@ -110,20 +492,76 @@ class imdb {
   /**
    * Method: getActorRecord
    * ----------------------
-   * Performs binary search, returns void ptr to ActorRecord if successfull,
+   * Probes the actor index if there is one and performs binary search
+   * otherwise, returns void ptr to ActorRecord if successfull,
    * otherwise void ptr to actorFile
    * @param name: name of an actor to search
    */
-  const void *getActorRecord(const char* name) const;
+  const void *getActorRecord(string_view name) const;
 
   /**
    * Method: getMovieRecord
    * ----------------------
-   * Performs binary search, returns void ptr to MovieRecord if successfull,
+   * Probes the movie index if there is one and performs binary search
+   * otherwise, returns void ptr to MovieRecord if successfull,
    * otherwise void ptr to movieFile
-   * @param movie: const ref to a film to search
+   * @param title, year: the film to search
+   */
+  const void *getMovieRecord(string_view title, int year) const;
+
+  /**
+   * Methods: hashName, hashMovie
+   * ----------------------------
+   * Hash an actor's name, and a film's title together with the year byte
+   * stored after it (the year minus 1900).
+   */
+  static unsigned int hashName(string_view name);
+  static unsigned int hashMovie(string_view title, int year);
+
+  /**
+   * Method: compareName
+   * -------------------
+   * Compares name with the '\0'-terminated string that starts a record,
+   * the way strcmp would (name itself needn't be terminated).
+   */
+  static int compareName(string_view name, const char *record);
+
+  /**
+   * Method: getOffsets
+   * ------------------
+   * Returns the offset array of the record that starts with a
+   * '\0'-terminated name followed by extra bytes (0 for actors, and
+   * 1, the year, for movies), and stores its length in count.  The
+   * name and extra bytes are padded to an even length, and the count
+   * that follows them to a multiple of four.
+   */
+  static const int *getOffsets(const char *record, int extra, int& count);
+
+  /**
+   * Struct: offsetRanks
+   * -------------------
+   * Maps record offsets to IDs.  Every record starts at a multiple of four
+   * bytes, and the records are laid out in the order of the offset table,
+   * so a record's ID is the number of records that start before it.  starts
+   * has a bit for every four bytes of the file, set where a record starts,
+   * and ranks[w] counts the records that start before the w-th word of
+   * starts, so an ID costs one lookup and one popcount.  Together they take
+   * about a twentieth of the size of the file.
    */
-  const void *getMovieRecord(const film& movie) const;
+  struct offsetRanks {
+    vector<unsigned long long> starts;
+    vector<int> ranks;
+  } actorRanks, movieRanks;
+
+  static void buildRanks(const void *file, size_t fileSize, offsetRanks& ranks);
+  static int getRank(const offsetRanks& ranks, int offset) {
+    unsigned int slot = (unsigned int) offset / 4;
+    unsigned long long below = ranks.starts[slot / 64] & ((1ULL << (slot % 64)) - 1);
+    return ranks.ranks[slot / 64] + __builtin_popcountll(below);
+  }
+
+  friend class ActorView;
+  friend class MovieView;
 
   // everything below here is complicated and needn't be touched.
   // you're free to investigate, but you're on your own.
@@ -131,11 +569,36 @@ class imdb {
     int fd;
     size_t fileSize;
     const void *fileMap;
-  } actorInfo, movieInfo;
+    fileStamp stamp;
+  } actorInfo, movieInfo, actorIndexInfo, movieIndexInfo, costarInfo;
 
   static const void *acquireFileMap(const string& fileName, struct fileInfo& info);
   static void releaseFileMap(struct fileInfo& info);
 
+  /**
+   * Method: loadIndex
+   * -----------------
+   * Maps the named index file and returns its buckets if it matches the
+   * specified data file, or NULL otherwise (also when it's missing).
+   */
+  static const indexBucket *loadIndex(const string& fileName, const struct fileInfo& data,
+                                      struct fileInfo& info, unsigned int& mask);
+
+  /**
+   * Method: writeIndex
+   * ------------------
+   * Builds and saves an index whose i-th record has the i-th hash.
+   */
+  static bool writeIndex(const string& fileName, const vector<unsigned int>& hashes, const fileStamp& dataStamp);
+
+  /**
+   * Method: loadCostars
+   * -------------------
+   * Maps the named co-star file and points costarStarts and costarData
+   * into it if it matches the data files, or leaves them NULL otherwise.
+   */
+  void loadCostars(const string& fileName);
+
   // marked as private so imdbs can't be copy constructed or reassigned.
   // if we were to allow this, we'd alias open files and accidentally close
   // files prematurely.. (do NOT implement these... since the client will
@@ -145,4 +608,34 @@ class imdb {
   imdb& operator=(const imdb& rhs) const;
 };
 
+inline ActorView::ActorView(const imdb *db, int offset) : db(db), record((const char *) db->actorFile + offset) {}
+inline int ActorView::getOffset() const { return record - (const char *) db->actorFile; }
+inline int ActorView::getId() const { return db->getActorId(getOffset()); }
+inline CreditsRange ActorView::getCredits() const
+{
+  int count;
+  const int *offsets = imdb::getOffsets(record, 0, count);
+  return CreditsRange(offsets, count, db);
+}
+
+inline MovieView::MovieView(const imdb *db, int offset) : db(db), record((const char *) db->movieFile + offset) {}
+inline int MovieView::getOffset() const { return record - (const char *) db->movieFile; }
+inline int MovieView::getId() const { return db->getMovieId(getOffset()); }
+inline CastRange MovieView::getCast() const
+{
+  int count;
+  const int *offsets = imdb::getOffsets(record, 1, count);
+  return CastRange(offsets, count, db);
+}
+
+inline const int *imdb::getOffsets(const char *record, int extra, int& count)
+{
+  size_t length = strlen(record) + 1 + extra;
+  length += length % 2;
+  count = *(const short *) (record + length);
+  length += 2;
+  length += (4 - length % 4) % 4;
+  return (const int *) (record + length);
+}
+
 #endif
@@ -0,0 +1,141 @@
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <fstream>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include "landmarks.h"
+#include "pathfinder.h"
+using namespace std;
+
+const int landmarks::kDefaultCount;
+const int landmarks::kUnbounded;
+const unsigned char landmarks::kUnreachable;
+const unsigned char landmarks::kFar;
+const char *const landmarks::kLandmarkFileName = "landmarks";
+const unsigned int landmarks::kLandmarkMagic = 0x4b524d4c; // "LMRK" when read on a little-endian machine
+
+/**
+ * Maps the file the same way imdb maps its own, and keeps it only if
+ * it was built from the same data files, unmodified since, and is
+ * exactly as long as its header says.
+ */
+
+landmarks::landmarks(const imdb& db, const string& directory) : fileSize(0), fileMap(NULL), numLandmarks(0), distances(NULL)
+{
+  struct stat stats;
+  fd = open((directory + "/" + kLandmarkFileName).c_str(), O_RDONLY);
+  if (fd == -1 || fstat(fd, &stats) != 0 || !db.good()) return;
+  fileSize = stats.st_size;
+  if (fileSize < sizeof(landmarkHeader)) return;
+  fileMap = mmap(0, fileSize, PROT_READ, MAP_SHARED, fd, 0);
+  if (fileMap == MAP_FAILED) {
+    fileMap = NULL;
+    return;
+  }
+
+  const landmarkHeader *header = (const landmarkHeader *) fileMap;
+  size_t prefix = sizeof(landmarkHeader) + header->numLandmarks * sizeof(int);
+  if (header->magic != kLandmarkMagic || header->numActors != (unsigned int) db.getNumActors() ||
+      !(header->actorStamp == db.getActorStamp()) || !(header->movieStamp == db.getMovieStamp()) ||
+      header->numLandmarks == 0 || fileSize != prefix + (size_t) header->numActors * header->numLandmarks)
+    return;
+  numLandmarks = header->numLandmarks;
+  distances = (const unsigned char *) fileMap + prefix;
+}
+
+landmarks::~landmarks()
+{
+  if (fileMap != NULL) munmap((char *) fileMap, fileSize);
+  if (fd != -1) close(fd);
+}
+
+/**
+ * Takes the tightest bounds any landmark gives.  A landmark too far
+ * from either actor to have its distance recorded tells us nothing.
+ */
+
+void landmarks::getBounds(int source, int target, int& lower, int& upper) const
+{
+  lower = 0;
+  upper = source == target ? 0 : kUnbounded;
+  const unsigned char *from = getRow(source), *to = getRow(target);
+  for (int i = 0; i < numLandmarks; i++) {
+    if (from[i] == kUnreachable && to[i] == kUnreachable) continue;
+    if (from[i] == kUnreachable || to[i] == kUnreachable) {
+      lower = upper = kUnbounded;
+      return;
+    }
+    if (from[i] == kFar || to[i] == kFar) continue;
+    lower = max(lower, abs(from[i] - to[i]));
+    upper = min(upper, from[i] + to[i]);
+  }
+}
+
+/**
+ * Ranks actors by the sum of their casts' sizes, an upper bound on their
+ * number of co-stars that doesn't need the co-star file, and takes them
+ * in that order, skipping those a landmark already chosen reaches in
+ * one movie.  If that leaves too few, the skipped ones are taken after
+ * all.  Distances go straight into the rows of the table, one column
+ * per landmark.
+ */
+
+bool landmarks::write(const imdb& db, const string& directory, int count, unsigned int threads)
+{
+  int num_actors = db.getNumActors();
+  count = max(1, min(count, num_actors));
+  vector<long long> degrees(num_actors, 0);
+  vector<int> candidates(num_actors);
+  for (int actor = 0; actor != num_actors; ++actor) {
+    for (MovieView movie : db.getActorById(actor).getCredits())
+      degrees[actor] += movie.getCast().size() - 1;
+    candidates[actor] = actor;
+  }
+  stable_sort(candidates.begin(), candidates.end(),
+              [&degrees](int a, int b) { return degrees[a] > degrees[b]; });
+
+  pathfinder finder(db, threads);
+  vector<int> chosen, distance, histogram;
+  vector<unsigned char> table((size_t) num_actors * count, kUnreachable);
+  vector<bool> taken(num_actors, false);
+  for (int pass = 0; pass != 2 && (int) chosen.size() != count; ++pass) {
+    for (int i = 0; i != num_actors && (int) chosen.size() != count; ++i) {
+      int candidate = candidates[i];
+      if (taken[candidate]) continue;
+      bool near = false;
+      for (unsigned int l = 0; l != chosen.size() && pass == 0; ++l)
+        if (table[(size_t) candidate * count + l] <= 1) near = true;
+      if (near) continue;
+
+      finder.findDistances(string(db.getActorById(candidate).getName()), distance, histogram);
+      for (int actor = 0; actor != num_actors; ++actor)
+        if (distance[actor] != -1)
+          table[(size_t) actor * count + chosen.size()] = min(distance[actor], (int) kFar);
+      taken[candidate] = true;
+      chosen.push_back(candidate);
+    }
+  }
+
+  landmarkHeader header = { kLandmarkMagic, (unsigned int) num_actors, (unsigned int) chosen.size(), 0,
+                            db.getActorStamp(), db.getMovieStamp() };
+  ofstream out((directory + "/" + kLandmarkFileName).c_str(), ios::binary | ios::trunc);
+  out.write((const char *) &header, sizeof(header));
+  if (!chosen.empty()) out.write((const char *) &chosen[0], chosen.size() * sizeof(int));
+  if (!table.empty()) out.write((const char *) &table[0], table.size());
+  out.close();
+  return out.good();
+}
+
+bool landmarks::parseCount(const char *text, int& count)
+{
+  char *end;
+  errno = 0;
+  long long value = strtoll(text, &end, 10);
+  if (end == text || *end != '\0' || errno == ERANGE || value < 0 || value > INT_MAX) return false;
+  count = value;
+  return true;
+}
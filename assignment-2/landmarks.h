@@ -0,0 +1,166 @@
+#ifndef __landmarks__
+#define __landmarks__
+
+#include "imdb.h"
+#include <string>
+#include <vector>
+#include <climits>
+#include <cstdlib>
+#include <algorithm>
+using namespace std;
+
+/**
+ * Class: landmarks
+ * ----------------
+ * A distance oracle for the actor graph of an imdb.  Offline, a handful
+ * of well-connected actors are chosen as landmarks, and the number of
+ * movies between each landmark and every actor is saved in the data
+ * directory as "landmarks" (see write).  Since distances obey the
+ * triangle inequality, for any landmark L,
+ *
+ *    |d(L, s) - d(L, t)|  <=  d(s, t)  <=  d(L, s) + d(L, t)
+ *
+ * so looking up two rows of bytes bounds the distance between any two
+ * people from both sides in microseconds, without searching at all.
+ * When one of them is a landmark, or sits on a shortest path between a
+ * landmark and the other, the two bounds meet and give the exact answer.
+ * If a landmark reaches one of them and not the other, they aren't
+ * connected at all.
+ *
+ * The pathfinder uses the same bounds to limit and prune its searches.
+ */
+
+class landmarks {
+
+ public:
+
+  /**
+   * Constants: kDefaultCount, kUnbounded
+   * ------------------------------------
+   * kDefaultCount is the number of landmarks chosen unless asked
+   * otherwise; kUnbounded stands in for an infinite bound.
+   */
+
+  static const int kDefaultCount = 16;
+  static const int kUnbounded = INT_MAX;
+
+  /**
+   * Constructor: landmarks
+   * ----------------------
+   * Maps the landmark file in the specified directory, if there's one
+   * that was built from the imdb's data files.  The imdb must outlive
+   * the landmarks.  Once loaded, landmarks are read-only and may be
+   * shared between threads.
+   */
+
+  landmarks(const imdb& db, const string& directory);
+  ~landmarks();
+
+  /**
+   * Predicate Method: good
+   * ----------------------
+   * Returns true if and only if an up-to-date landmark file was found.
+   * None of the other methods may be called otherwise.
+   */
+
+  bool good() const { return distances != NULL; }
+
+  /**
+   * Method: getBounds
+   * -----------------
+   * Bounds the number of movies on a shortest path between the actors
+   * with the specified IDs.  lower is set to kUnbounded if they're known
+   * not to be connected, and upper is set to kUnbounded if no landmark
+   * reaches either of them.
+   */
+
+  void getBounds(int source, int target, int& lower, int& upper) const;
+
+  /**
+   * Method: getLowerBound
+   * ---------------------
+   * Returns just the lower bound of getBounds, which is all a search
+   * needs to prune an actor: if the actor's distance from the start of
+   * the search plus its lower bound to the goal exceeds the length of a
+   * path known to exist, it can't be on a shortest one.
+   */
+
+  int getLowerBound(int actor, int target) const
+  {
+    const unsigned char *from = getRow(actor), *to = getRow(target);
+    int lower = 0;
+    for (int i = 0; i < numLandmarks; i++) {
+      if (from[i] == kUnreachable && to[i] == kUnreachable) continue;
+      if (from[i] == kUnreachable || to[i] == kUnreachable) return kUnbounded;
+      if (from[i] == kFar || to[i] == kFar) continue;
+      lower = max(lower, abs(from[i] - to[i]));
+    }
+    return lower;
+  }
+
+  /**
+   * Method: write
+   * -------------
+   * Chooses landmarks and saves every actor's distance from each of them
+   * in the specified directory, as "landmarks".  Landmarks are chosen
+   * in decreasing order of how many co-stars they could have, passing
+   * over anyone within one movie of a landmark already chosen, whose
+   * distances would add little, and each one costs one breadth-first
+   * search of the whole database.
+   *
+   * @param db the database the landmarks are chosen from.
+   * @param directory the name of the directory the file is written to.
+   * @param count the number of landmarks (fewer if there aren't as many actors).
+   * @param threads the number of threads each search may use.
+   * @return true if and only if the file was written in full.
+   */
+
+  static bool write(const imdb& db, const string& directory, int count = kDefaultCount, unsigned int threads = 1);
+
+  /**
+   * Function: parseCount
+   * --------------------
+   * Reads a number of landmarks from a command line argument, the same
+   * way pathfinder::parseThreads reads a thread count.  The count must
+   * be an integer from 0 to INT_MAX; 0 means no landmarks at all.
+   *
+   * @return false (leaving count alone) if text isn't such an integer.
+   */
+
+  static bool parseCount(const char *text, int& count);
+
+ private:
+  static const char *const kLandmarkFileName;
+  static const unsigned int kLandmarkMagic;
+  static const unsigned char kUnreachable = 255;  // the actor isn't connected to the landmark
+  static const unsigned char kFar = 254;          // the actor is at least this many movies away
+
+  /**
+   * Layout of the landmark file: this header, then the landmarks' actor
+   * IDs, then one row of numLandmarks distances per actor, in order of ID,
+   * so that the distances of one actor are next to each other.
+   */
+
+  struct landmarkHeader {
+    unsigned int magic;         // kLandmarkMagic, which also rules out files of the other byte order
+    unsigned int numActors;     // number of records in the actor file
+    unsigned int numLandmarks;
+    unsigned int unused;        // always 0, so the stamps are aligned without padding
+    imdb::fileStamp actorStamp; // stamp of the actor file it was built from
+    imdb::fileStamp movieStamp; // stamp of the movie file it was built from
+  };
+
+  int fd;
+  size_t fileSize;
+  const void *fileMap;
+  int numLandmarks;
+  const unsigned char *distances;  // NULL unless an up-to-date landmark file was found
+
+  const unsigned char *getRow(int actor) const { return distances + (size_t) actor * numLandmarks; }
+
+  // marked as private so landmarks can't be copied, for the same reason imdbs can't
+  landmarks(const landmarks& original);
+  landmarks& operator=(const landmarks& rhs);
+};
+
+#endif
@@ -76,3 +76,14 @@ ostream& operator<<(ostream& os, const path& p)
 
   return os;
 }
+
+/**
+ * Same walk as operator<<, but with every leg on one line.
+ */
+
+void path::printOnOneLine(ostream& os) const
+{
+  os << startPlayer;
+  for (int i = 0; i < (int) links.size(); i++)
+    os << " > \"" << links[i].movie.title << "\" (" << links[i].movie.year << ") > " << links[i].player;
+}
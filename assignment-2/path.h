@@ -113,6 +113,18 @@ class path {
    */
 
   void reverse();
+
+  /**
+   * Method: printOnOneLine
+   * ----------------------
+   * Publishes the path on a single line, with no tabs, as
+   * player > "title" (year) > player > ..., which is how batch
+   * results are written.  No newline is printed.
+   *
+   * @param os the stream the path is written to.
+   */
+
+  void printOnOneLine(ostream& os) const;
   
  private:
   // private struct definition... no one else uses it, so I define it internally
@@ -0,0 +1,300 @@
+#include "pathfinder.h"
+#include "landmarks.h"
+#include <algorithm>
+#include <thread>
+#include <cstdlib>
+using namespace std;
+
+const int pathfinder::kMaxPathLength;
+const unsigned int pathfinder::kMaxThreads;
+const size_t pathfinder::kActorsPerChunk;
+const size_t pathfinder::kMinActorsPerThread;
+
+/**
+ * Bitset helpers: testBit reports whether bit i is set, and setBit sets
+ * it and reports whether it was set already.  Only a shared bitset,
+ * one other threads may be setting bits of at the same time, needs the
+ * read and the write to be one atomic step; a bit that's already set
+ * stays set, so that step is skipped when a plain read finds it.
+ */
+
+static inline bool testBit(const vector<atomic<unsigned long long> >& bits, int i)
+{
+  return (bits[i / 64].load(memory_order_relaxed) >> (i % 64)) & 1;
+}
+
+static inline bool setBit(vector<atomic<unsigned long long> >& bits, int i, bool shared)
+{
+  atomic<unsigned long long>& word = bits[i / 64];
+  unsigned long long mask = 1ULL << (i % 64);
+  unsigned long long old = word.load(memory_order_relaxed);
+  if (old & mask) return true;
+  if (shared) return word.fetch_or(mask, memory_order_relaxed) & mask;
+  word.store(old | mask, memory_order_relaxed);
+  return false;
+}
+
+bool pathfinder::parseThreads(const char *text, unsigned int& threads)
+{
+  char *end;
+  long long count = strtoll(text, &end, 10);
+  if (end == text || *end != '\0' || count <= 0) return false;
+  threads = min<long long>(count, kMaxThreads);
+  return true;
+}
+
+/**
+ * Sizes every array of both sides to the database, once and for all.
+ */
+
+pathfinder::pathfinder(const imdb& db, unsigned int threads, const landmarks *oracle) :
+  db(db), threads(max(1U, threads)), useCostars(false), oracle(oracle), limit(kMaxPathLength)
+{
+  for (int i = 0; i < 2; i++) {
+    sides[i].reachedActors = bits(db.getNumActors() / 64 + 1);
+    sides[i].expandedMovies = bits(db.getNumMovies() / 64 + 1);
+    sides[i].previousActors.resize(db.getNumActors());
+    sides[i].previousMovies.resize(db.getNumActors());
+    sides[i].depths.resize(db.getNumActors());
+  }
+}
+
+/**
+ * Clears what the last search left behind and seeds the side with
+ * its starting actor.
+ */
+
+void pathfinder::startSide(searchSide& side, int actor)
+{
+  for (size_t w = 0; w < side.reachedActors.size(); w++) side.reachedActors[w].store(0, memory_order_relaxed);
+  for (size_t w = 0; w < side.expandedMovies.size(); w++) side.expandedMovies[w].store(0, memory_order_relaxed);
+  setBit(side.reachedActors, actor, false);
+  side.previousActors[actor] = -1;
+  side.previousMovies[actor] = -1;
+  side.depths[actor] = 0;
+  side.frontier.assign(1, actor);
+  side.depth = 0;
+}
+
+/**
+ * Expands the frontier actors from begin up to end by one movie: each
+ * movie not yet expanded from this side contributes its whole cast,
+ * and every cast member not reached before joins share.next.  Any of
+ * them the other side (if there is one) has already reached completes
+ * a path, and the shortest such path is recorded in the share.  Credits and casts are
+ * read straight from the records' offset arrays, and each offset is
+ * turned into an ID without a search.  When useCostars is set, each
+ * actor's co-stars are read from the database's co-star file instead,
+ * in one step and once apiece, and the movie bitset isn't needed.
+ *
+ * With landmarks, an actor is passed over if, as far as they can tell,
+ * it can't lie on a path of at most limit movies.  An actor on a
+ * shortest path always passes that test, so nothing it leads to is
+ * lost.  Actors are tested when they're about to be expanded, rather
+ * than when they're reached, since most actors a search reaches are
+ * never expanded at all.
+ *
+ * The other side isn't touched until the level is over, so it can be
+ * read freely, and an actor's predecessor and depth are written only
+ * by the one expansion that managed to set its bit.
+ */
+
+void pathfinder::expandActors(searchSide& side, const searchSide *other, size_t begin, size_t end, bool shared,
+                              levelShare& share) const
+{
+  for (size_t i = begin; i < end; i++) {
+    int actor = side.frontier[i];
+    if (other != NULL && oracle != NULL && oracle->getLowerBound(actor, side.goal) > limit - side.depth) continue;
+    if (useCostars) {
+      for (const costarLink& link : db.getCostars(actor)) {
+        if (setBit(side.reachedActors, link.actor, shared)) continue;
+        reach(side, other, actor, link.movie, link.actor, share);
+      }
+      continue;
+    }
+    CreditsRange credits = db.getActorById(actor).getCredits();
+    for (int c = 0; c < credits.size(); c++) {
+      int movie = db.getMovieId(credits.getOffsets()[c]);
+      if (setBit(side.expandedMovies, movie, shared)) continue;
+      CastRange cast = credits[c].getCast();
+      for (int k = 0; k < cast.size(); k++) {
+        int costar = db.getActorId(cast.getOffsets()[k]);
+        if (setBit(side.reachedActors, costar, shared)) continue;
+        reach(side, other, actor, movie, costar, share);
+      }
+    }
+  }
+}
+
+/**
+ * Records that costar, whose bit the caller has just set, was reached
+ * from actor through movie, and checks whether it completes a path.
+ */
+
+void pathfinder::reach(searchSide& side, const searchSide *other, int actor, int movie, int costar,
+                       levelShare& share) const
+{
+  side.previousActors[costar] = actor;
+  side.previousMovies[costar] = movie;
+  side.depths[costar] = side.depth + 1;
+  share.next.push_back(costar);
+  if (other != NULL && testBit(other->reachedActors, costar) && side.depth + 1 + other->depths[costar] < share.best) {
+    share.best = side.depth + 1 + other->depths[costar];
+    share.meeting = costar;
+  }
+}
+
+/**
+ * Worker body for a parallel level: repeatedly claims the next chunk
+ * of the frontier and expands it, until the frontier runs out.
+ */
+
+void pathfinder::expandChunks(searchSide& side, const searchSide *other, atomic<size_t>& nextChunk,
+                              levelShare& share) const
+{
+  while (true) {
+    size_t begin = nextChunk.fetch_add(kActorsPerChunk);
+    if (begin >= side.frontier.size()) break;
+    expandActors(side, other, begin, min(begin + kActorsPerChunk, side.frontier.size()), true, share);
+  }
+}
+
+/**
+ * Expands side's whole frontier by one level, replaces the frontier
+ * with the actors it reached, and lowers best (recording the meeting
+ * point) if it completed a shorter path.  A level large enough to keep
+ * every thread busy is dealt out to the workers in chunks, since a few
+ * prolific actors can account for most of a level's work.  Each worker
+ * collects its own share of the next frontier, and the shares are
+ * concatenated once they've all finished.
+ */
+
+void pathfinder::expandFrontier(searchSide& side, const searchSide *other, int& best, int& meeting)
+{
+  vector<levelShare> shares(side.frontier.size() < threads * kMinActorsPerThread ? 1 : threads);
+  for (size_t i = 0; i < shares.size(); i++) {
+    shares[i].best = best;
+    shares[i].meeting = meeting;
+  }
+
+  if (shares.size() == 1) {
+    expandActors(side, other, 0, side.frontier.size(), false, shares[0]);
+  } else {
+    atomic<size_t> nextChunk(0);
+    vector<thread> workers;
+    for (size_t i = 0; i < shares.size(); i++)
+      workers.push_back(thread(&pathfinder::expandChunks, this, ref(side), other, ref(nextChunk), ref(shares[i])));
+    for (size_t i = 0; i < workers.size(); i++)
+      workers[i].join();
+  }
+
+  side.frontier.clear();
+  for (size_t i = 0; i < shares.size(); i++) {
+    side.frontier.insert(side.frontier.end(), shares[i].next.begin(), shares[i].next.end());
+    if (shares[i].best < best) {
+      best = shares[i].best;
+      meeting = shares[i].meeting;
+    }
+  }
+  side.depth++;
+}
+
+/**
+ * A search grows out of each end, and each round advances whichever
+ * one has the smaller frontier by a whole level, until the two meet.
+ * The two halves of a path are then each about half as long as the
+ * whole, so far fewer actors are ever touched than by one search
+ * growing all the way from the source.  Finishing the level in which
+ * they first meet, and keeping the shortest of the paths completed
+ * during it, makes the result a shortest path.  It's assembled by
+ * following the predecessor arrays from the meeting point back to the
+ * source and on to the target.  With landmarks, the search never has
+ * to look past the shortest path they guarantee, and may not need to
+ * start at all.
+ */
+
+bool pathfinder::findShortestPath(const string& source, const string& target, path& result)
+{
+  ActorView sourceActor, targetActor;
+  db.getActor(source, sourceActor);
+  db.getActor(target, targetActor);
+  searchSide& fromSource = sides[0];
+  searchSide& fromTarget = sides[1];
+  useCostars = db.hasCostars();
+  startSide(fromSource, sourceActor.getId());
+  startSide(fromTarget, targetActor.getId());
+  fromSource.goal = targetActor.getId();
+  fromTarget.goal = sourceActor.getId();
+
+  limit = kMaxPathLength;
+  if (oracle != NULL) {
+    int lower, upper;
+    oracle->getBounds(sourceActor.getId(), targetActor.getId(), lower, upper);
+    if (lower > kMaxPathLength) return false;
+    limit = min(limit, upper);
+  }
+
+  int best = limit + 1, meeting = -1;
+  while (meeting == -1 && !fromSource.frontier.empty() && !fromTarget.frontier.empty() &&
+         fromSource.depth + fromTarget.depth < limit) {
+    if (fromSource.frontier.size() <= fromTarget.frontier.size()) {
+      expandFrontier(fromSource, &fromTarget, best, meeting);
+    } else {
+      expandFrontier(fromTarget, &fromSource, best, meeting);
+    }
+  }
+  if (meeting == -1) return false;
+
+  vector<int> firstHalf;
+  for (int actor = meeting; fromSource.previousActors[actor] != -1; actor = fromSource.previousActors[actor])
+    firstHalf.push_back(actor);
+
+  result = path(source);
+  for (size_t i = firstHalf.size(); i > 0; i--) {
+    int actor = firstHalf[i - 1];
+    result.addConnection(db.getMovieById(fromSource.previousMovies[actor]).getFilm(),
+                         string(db.getActorById(actor).getName()));
+  }
+  for (int actor = meeting; fromTarget.previousActors[actor] != -1; actor = fromTarget.previousActors[actor]) {
+    result.addConnection(db.getMovieById(fromTarget.previousMovies[actor]).getFilm(),
+                         string(db.getActorById(fromTarget.previousActors[actor]).getName()));
+  }
+  return true;
+}
+
+/**
+ * Grows a single side from source until it runs out of actors, with no
+ * other side to meet, and reads each level's distance off the level
+ * itself.  The side's own depths are bytes, which is plenty for a path
+ * of six, so they aren't relied on here.
+ *
+ * A sweep over everything goes through credits and casts even when
+ * there's a co-star file: with the movie bitset, each cast is read once
+ * per sweep, whereas the co-star lists hold every pair of cast members,
+ * which for big casts is far more to read.  A search between two people
+ * stops long before it has read most of them, and that's where skipping
+ * the movies pays.
+ */
+
+int pathfinder::findDistances(const string& source, vector<int>& distances, vector<int>& histogram)
+{
+  ActorView sourceActor;
+  db.getActor(source, sourceActor);
+  searchSide& side = sides[0];
+  startSide(side, sourceActor.getId());
+  useCostars = false;
+  distances.assign(db.getNumActors(), -1);
+  distances[sourceActor.getId()] = 0;
+  histogram.assign(1, 1);
+
+  int reached = 1, best = 0, meeting = -1;
+  while (true) {
+    expandFrontier(side, NULL, best, meeting);
+    if (side.frontier.empty()) break;
+    for (size_t i = 0; i < side.frontier.size(); i++)
+      distances[side.frontier[i]] = side.depth;
+    histogram.push_back(side.frontier.size());
+    reached += side.frontier.size();
+  }
+  return reached;
+}
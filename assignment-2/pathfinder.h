@@ -0,0 +1,178 @@
+#ifndef __pathfinder__
+#define __pathfinder__
+
+#include "imdb.h"
+#include "path.h"
+#include <vector>
+#include <atomic>
+using namespace std;
+
+class landmarks;
+
+/**
+ * Class: pathfinder
+ * -----------------
+ * Finds shortest paths of movies and co-stars between two actors or
+ * actresses of an imdb.  The searches run entirely on the records'
+ * integer IDs (see ActorView::getId): who has been reached and which
+ * movies have been expanded are bitsets, how each actor was reached is
+ * a pair of predecessor arrays, and names are only looked at once a
+ * path has been found and has to be returned as a path.
+ *
+ * All of that state is sized to the whole database and allocated once,
+ * when the pathfinder is constructed, so each search only has to clear
+ * the bitsets.  A pathfinder is therefore meant to be reused across
+ * queries, but it isn't meant to be shared between threads; give each
+ * thread a pathfinder of its own over the same imdb.
+ *
+ * A pathfinder can also spread each search over several threads of its
+ * own.  The search still advances one level at a time, but the actors
+ * of a large level are dealt out to worker threads in small chunks, and
+ * the workers claim movies and actors by atomically setting their bits,
+ * so each is expanded by exactly one of them.  The paths found are just
+ * as short, though which of several shortest paths comes back can then
+ * depend on how the threads are scheduled.
+ *
+ * Given landmarks (see landmarks.h), a pathfinder turns down pairs the
+ * landmarks prove too far apart without searching at all, stops looking
+ * once paths would be longer than one the landmarks prove exists, and
+ * stops growing a search from any actor whose distance so far, plus the
+ * landmarks' lower bound on the rest of the way, already exceeds that.
+ * None of it can cost a shortest path.
+ */
+
+class pathfinder {
+
+ public:
+
+  /**
+   * Constant: kMaxPathLength
+   * ------------------------
+   * Longest path (in movies) worth looking for.  If two people aren't
+   * connected by six movies or fewer, it's a safe bet they aren't connected.
+   */
+
+  static const int kMaxPathLength = 6;
+
+  /**
+   * Constant: kMaxThreads
+   * ---------------------
+   * Most threads a search (or a batch of them) will be given, however
+   * many are asked for.  Each batch thread has a pathfinder of its own,
+   * and each pathfinder holds arrays the size of the database.
+   */
+
+  static const unsigned int kMaxThreads = 256;
+
+  /**
+   * Function: parseThreads
+   * ----------------------
+   * Reads a thread count from a command line argument.  The count must
+   * be a positive integer, and anything over kMaxThreads is lowered to
+   * kMaxThreads.
+   *
+   * @return false (leaving threads alone) if text isn't a positive integer.
+   */
+
+  static bool parseThreads(const char *text, unsigned int& threads);
+
+  /**
+   * Constructor: pathfinder
+   * -----------------------
+   * Constructs a pathfinder over the specified imdb, which must outlive it.
+   *
+   * @param db the database searched.
+   * @param threads the number of threads each search may use.
+   * @param oracle the landmarks used to bound searches, or NULL.  Like
+   *               the imdb, they must outlive the pathfinder.
+   */
+
+  pathfinder(const imdb& db, unsigned int threads = 1, const landmarks *oracle = NULL);
+
+  /**
+   * Method: findShortestPath
+   * ------------------------
+   * Searches for a shortest path from source to target, both of which
+   * must be in the database, with a bidirectional breadth-first search.
+   *
+   * @param source the actor or actress the path starts with.
+   * @param target the actor or actress the path ends with.
+   * @param result the path that's overwritten with the answer.
+   * @return true if a path of at most kMaxPathLength movies was found.
+   */
+
+  bool findShortestPath(const string& source, const string& target, path& result);
+
+  /**
+   * Method: findDistances
+   * ---------------------
+   * Computes the degree map of source: how many movies separate it from
+   * every other actor or actress in the database, with no limit on the
+   * length of the path.  It's one breadth-first search from source over
+   * the whole database, so it costs about as much as a single search
+   * between two people that aren't connected, rather than one search
+   * per person.
+   *
+   * @param source the actor or actress the distances are measured from,
+   *               who must be in the database.
+   * @param distances overwritten with one entry per actor ID (see
+   *                  ActorView::getId): the number of movies between
+   *                  source and that actor, or -1 if there's no path.
+   * @param histogram overwritten so that histogram[d] is the number of
+   *                  actors d movies away from source.
+   * @return the number of actors reachable from source, source included.
+   */
+
+  int findDistances(const string& source, vector<int>& distances, vector<int>& histogram);
+
+ private:
+
+  static const size_t kActorsPerChunk = 16;       // frontier actors a worker claims at a time
+  static const size_t kMinActorsPerThread = 256;  // levels smaller than this per thread are expanded serially
+
+  typedef vector<atomic<unsigned long long> > bits;
+
+  /**
+   * One half of a bidirectional search, growing outward from one actor.
+   * The predecessor arrays and depths are only meaningful for actors
+   * whose bit in reachedActors is set, and are only written by whoever
+   * set it.
+   */
+
+  struct searchSide {
+    bits reachedActors;                         // bit per actor ID
+    bits expandedMovies;                        // bit per movie ID
+    vector<int> previousActors;                 // actor ID -> co-star it was reached from, or -1 at the start
+    vector<int> previousMovies;                 // actor ID -> the movie it shares with that co-star
+    vector<unsigned char> depths;               // actor ID -> movies away from the start
+    vector<int> frontier;                       // actors reached in the last round
+    int depth;                                  // movies away from the start of every frontier actor
+    int goal;                                   // the actor the other side starts from
+  };
+
+  /**
+   * What one thread found while expanding its share of a level.
+   */
+
+  struct levelShare {
+    vector<int> next;                           // actors it reached first
+    int best;                                   // length of the shortest path it completed
+    int meeting;                                // where that path's halves meet, or -1
+  };
+
+  const imdb& db;
+  unsigned int threads;
+  bool useCostars;                              // step from actor to actor through the co-star file
+  const landmarks *oracle;
+  int limit;                                    // length of the longest path still worth finding
+  searchSide sides[2];                          // growing from the source, and from the target
+
+  void startSide(searchSide& side, int actor);
+  void expandFrontier(searchSide& side, const searchSide *other, int& best, int& meeting);
+  void expandActors(searchSide& side, const searchSide *other, size_t begin, size_t end, bool shared,
+                    levelShare& share) const;
+  void reach(searchSide& side, const searchSide *other, int actor, int movie, int costar, levelShare& share) const;
+  void expandChunks(searchSide& side, const searchSide *other, atomic<size_t>& nextChunk, levelShare& share) const;
+};
+
+#endif
@@ -1,65 +1,59 @@
 #include <vector>
-#include <list>
-#include <set>
 #include <string>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <thread>
+#include <chrono>
 #include "imdb.h"
 #include "path.h"
+#include "pathfinder.h"
+#include "landmarks.h"
 using namespace std;
 
-static void generateShortestPath(const string& source, const string& target, const imdb& db) {
-  list<path> partialPaths;
-  set<string> previouslySeenActors;
-  set<film> previouslySeenFilms;
-
-  // create a partial path around the source actor and add it to paths queue
-  partialPaths.push_back(path(source));
-
-  while (!partialPaths.empty() && (partialPaths.front().getLength() < 6)) {
-    // pull off front path
-    path frontPath(partialPaths.front());
-    partialPaths.pop_front();
-
-    // look through the last player's movies
-    vector<film> actorFilms;
-    if (db.getCredits(frontPath.getLastPlayer(), actorFilms)) {
-        for (vector<film>::iterator film_iter = actorFilms.begin(); film_iter != actorFilms.end(); ++film_iter) {
-          // for all unseen movies
-          if (previouslySeenFilms.find(*film_iter) == previouslySeenFilms.end()) {
-            // add to set of previously seen movies
-            previouslySeenFilms.insert(*film_iter);
-
-            // look up the film's cast
-            vector<string> filmCast;
-            if (db.getCast(*film_iter, filmCast)) {
-              for (vector<string>::iterator cast_iter = filmCast.begin(); cast_iter != filmCast.end(); ++cast_iter) {
-                // for all unseen actors
-                if (previouslySeenActors.find(*cast_iter) == previouslySeenActors.end()) {
-                  // add to previously seen actors
-                  previouslySeenActors.insert(*cast_iter);
-
-                  // clone the path
-                  path clonedPath = frontPath;
-
-                  // add connection
-                  clonedPath.addConnection(*film_iter, *cast_iter);
-
-                  // we found the target
-                  if (*cast_iter == target) {
-                    cout << clonedPath;
-                    return;
-                  } else {
-                    partialPaths.push_back(clonedPath);
-                  }
-                }
-              }
-            }
-          }
-      }
-    }
+/**
+ * Prints a shortest path from source to target, or a note that there's
+ * none worth mentioning.  The pathfinder does all of the searching.
+ */
+
+static void generateShortestPath(const string& source, const string& target, pathfinder& finder) {
+  path shortestPath(source);
+  if (finder.findShortestPath(source, target, shortestPath)) {
+    cout << shortestPath;
+  } else {
+    cout << endl << "No path between those two people could be found." << endl << endl;
   }
-  cout << endl << "No path between those two people could be found." << endl << endl;
+}
+
+/**
+ * Prints the landmarks' bounds on the distance from source to target,
+ * and how long it took to work them out, instead of searching for a path.
+ */
+
+static void printEstimate(const string& source, const string& target, const imdb& db, const landmarks& oracle) {
+  ActorView sourceActor, targetActor;
+  db.getActor(source, sourceActor);
+  db.getActor(target, targetActor);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  int lower, upper;
+  oracle.getBounds(sourceActor.getId(), targetActor.getId(), lower, upper);
+  double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  cout << "\t";
+  if (lower == landmarks::kUnbounded) {
+    cout << source << " and " << target << " aren't connected at all.";
+  } else if (lower == upper) {
+    cout << source << " and " << target << " are exactly " << lower << " movies apart.";
+  } else if (upper == landmarks::kUnbounded) {
+    cout << source << " and " << target << " are at least " << lower << " movies apart.";
+  } else {
+    cout << source << " and " << target << " are " << lower << " to " << upper << " movies apart.";
+  }
+  cout << " (" << fixed << setprecision(1) << elapsed * 1e6 << " microseconds)" << endl;
 }
 
 /**
@@ -84,37 +78,297 @@ static string promptForActor(const string& prompt, const imdb& db)
     cout << prompt << " [or <enter> to quit]: ";
     getline(cin, response);
     if (response == "") return "";
-    vector<film> credits;
-    if (db.getCredits(response, credits)) return response;
+    ActorView actor;
+    if (db.getActor(response, actor)) return response;
     cout << "We couldn't find \"" << response << "\" in the movie database. "
 	 << "Please try again." << endl;
   }
 }
 
+/**
+ * One line of a batch: the pair asked about and, once it's been
+ * answered, everything that's written back about it.
+ */
+
+struct query {
+  string source;
+  string target;
+  int length;            // movies in the shortest path, -1 if there isn't one, or kUnknownPair
+  bool known;            // false if either name isn't in the database
+  string answer;         // the path on one line, or why there isn't one
+  double seconds;        // time taken to answer it
+};
+
+/**
+ * What a batch reports in place of a path length when either name of
+ * a pair isn't in the database, to tell it apart from a pair that just
+ * isn't connected.
+ */
+
+static const int kUnknownPair = -2;
+
+/**
+ * Reads the (source, target) pairs of a batch from the named file, one
+ * tab-separated pair per line.  Blank lines and lines starting with '#'
+ * are skipped, and so, with a complaint, are lines without a tab.
+ *
+ * @return false if the file can't be opened.
+ */
+
+static bool readQueries(const char *fileName, vector<query>& queries)
+{
+  ifstream in(fileName);
+  if (!in) return false;
+  string line;
+  for (int line_number = 1; getline(in, line); line_number++) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.empty() || line[0] == '#') continue;
+    size_t tab = line.find('\t');
+    if (tab == string::npos) {
+      cerr << fileName << ":" << line_number << ": expected two names separated by a tab" << endl;
+      continue;
+    }
+    query q;
+    q.source = line.substr(0, tab);
+    q.target = line.substr(tab + 1);
+    q.length = -1;
+    q.known = false;
+    q.seconds = 0;
+    queries.push_back(q);
+  }
+  return true;
+}
+
+/**
+ * Worker body for a batch: with a pathfinder of its own over the shared
+ * imdb, repeatedly claims the next unanswered query and answers it, until
+ * none are left.  Queries are claimed one at a time, since even a quick
+ * one is far more work than claiming it, and that keeps a few slow
+ * queries from holding up the rest of the batch.
+ */
+
+static void answerQueries(const imdb& db, const landmarks *oracle, vector<query>& queries, atomic<size_t>& nextQuery)
+{
+  pathfinder finder(db, 1, oracle);
+  while (true) {
+    size_t i = nextQuery.fetch_add(1);
+    if (i >= queries.size()) break;
+    query& q = queries[i];
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    ActorView actor;
+    q.known = db.getActor(q.source, actor) && db.getActor(q.target, actor);
+    if (!q.known) {
+      q.length = kUnknownPair;
+      q.answer = "unknown actor or actress";
+    } else if (q.source == q.target) {
+      q.length = 0;
+      q.answer = q.source;
+    } else {
+      path shortestPath(q.source);
+      if (finder.findShortestPath(q.source, q.target, shortestPath)) {
+        ostringstream answer;
+        shortestPath.printOnOneLine(answer);
+        q.length = shortestPath.getLength();
+        q.answer = answer.str();
+      } else {
+        q.answer = "no path";
+      }
+    }
+    q.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  }
+}
+
+/**
+ * Answers every pair in pairsFileName with the specified number of
+ * worker threads, all sharing the one imdb, and writes one
+ * tab-separated line per pair, in the order of the pairs, to the named
+ * output file (or to standard output if there isn't one):
+ *
+ *    source  target  movies  microseconds  path
+ *
+ * where movies is -1 when there's no path, and kUnknownPair when either
+ * name isn't in the database.  No more threads are started than there
+ * are pairs.  A summary with the median and slowest latencies, and the
+ * number of pairs with unknown names, goes to standard error.
+ *
+ * @return 0 on success, and 2 if a file couldn't be opened.
+ */
+
+static int runBatch(const imdb& db, const landmarks *oracle, const char *pairsFileName, const char *outputFileName,
+                    unsigned int threads)
+{
+  vector<query> queries;
+  if (!readQueries(pairsFileName, queries)) {
+    cerr << "Couldn't open \"" << pairsFileName << "\"." << endl;
+    return 2;
+  }
+  ofstream outputFile;
+  if (outputFileName != NULL) {
+    outputFile.open(outputFileName);
+    if (!outputFile) {
+      cerr << "Couldn't create \"" << outputFileName << "\"." << endl;
+      return 2;
+    }
+  }
+  ostream& out = outputFileName != NULL ? outputFile : cout;
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  threads = max<size_t>(1, min<size_t>(threads, queries.size()));
+  atomic<size_t> nextQuery(0);
+  vector<thread> workers;
+  for (unsigned int i = 0; i < threads; i++)
+    workers.push_back(thread(answerQueries, cref(db), oracle, ref(queries), ref(nextQuery)));
+  for (size_t i = 0; i < workers.size(); i++)
+    workers[i].join();
+  double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  out << "# source\ttarget\tmovies\tmicroseconds\tpath" << endl;
+  vector<double> latencies;
+  size_t unknown = 0;
+  for (size_t i = 0; i < queries.size(); i++) {
+    const query& q = queries[i];
+    if (!q.known) unknown++;
+    out << q.source << "\t" << q.target << "\t" << q.length << "\t"
+        << (long long) (q.seconds * 1e6) << "\t" << q.answer << "\n";
+    latencies.push_back(q.seconds);
+  }
+  out.flush();
+
+  cerr << "Answered " << queries.size() << " pairs in " << fixed << setprecision(3) << elapsed
+       << " seconds with " << threads << " thread" << (threads == 1 ? "" : "s");
+  if (!latencies.empty()) {
+    sort(latencies.begin(), latencies.end());
+    cerr << "; median latency " << latencies[latencies.size() / 2] * 1e3 << " ms, slowest "
+         << latencies.back() * 1e3 << " ms";
+  }
+  if (unknown > 0) cerr << "; " << unknown << " had names that aren't in the database";
+  cerr << "." << endl;
+  return 0;
+}
+
+/**
+ * Writes the degree map of source: one tab-separated line per actor or
+ * actress it's connected to, in the order of the database, with the
+ * number of movies separating them,
+ *
+ *    actor  movies
+ *
+ * to the named output file (or to standard output if there isn't one),
+ * followed on standard error by a histogram of those distances.
+ *
+ * @return 0 on success, 2 if the output file couldn't be created, and
+ *         3 if source isn't in the database.
+ */
+
+static int runDegreeMap(const imdb& db, const string& source, const char *outputFileName, unsigned int threads)
+{
+  ActorView actor;
+  if (!db.getActor(source, actor)) {
+    cerr << "We couldn't find \"" << source << "\" in the movie database." << endl;
+    return 3;
+  }
+  ofstream outputFile;
+  if (outputFileName != NULL) {
+    outputFile.open(outputFileName);
+    if (!outputFile) {
+      cerr << "Couldn't create \"" << outputFileName << "\"." << endl;
+      return 2;
+    }
+  }
+  ostream& out = outputFileName != NULL ? outputFile : cout;
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  pathfinder finder(db, threads);
+  vector<int> distances, histogram;
+  int reached = finder.findDistances(source, distances, histogram);
+  double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+  for (int id = 0; id < db.getNumActors(); id++)
+    if (distances[id] != -1) out << db.getActorById(id).getName() << "\t" << distances[id] << "\n";
+  out.flush();
+
+  cerr << source << " is connected to " << reached << " of the " << db.getNumActors()
+       << " actors and actresses (" << fixed << setprecision(3) << elapsed << " seconds):" << endl;
+  for (size_t d = 0; d < histogram.size(); d++)
+    cerr << setw(8) << d << setw(10) << histogram[d] << endl;
+  cerr << setw(8) << "none" << setw(10) << db.getNumActors() - reached << endl;
+  return 0;
+}
+
 /**
  * Serves as the main entry point for the six-degrees executable.
- * There are no parameters to speak of.
  *
  * @param argc the number of tokens passed to the command line to
- *             invoke this executable.  It's completely ignored
- *             here, because we don't expect any arguments.
- * @param argv the C strings making up the full command line.
- *             We expect argv[0] to be logically equivalent to
- *             "six-degrees" (or whatever absolute path was used to
- *             invoke the program), but otherwise these are ignored
- *             as well.
+ *             invoke this executable.
+ * @param argv the C strings making up the full command line.  The one
+ *             argument that isn't an option, if any, names the directory
+ *             holding the data files, and "--threads N" lets each search
+ *             use N threads.  With "--batch <pairs file>", the pairs are
+ *             answered without prompting, N at a time, and the results
+ *             are written to the "--output <file>" (see runBatch), and
+ *             with "--degrees <name>", the distance from that one person
+ *             to everyone else is (see runDegreeMap).  If the data
+ *             directory holds landmarks (see landmarks.h), searches use
+ *             them, and "--estimate" answers with their bounds instead
+ *             of a path.
  * @return 0 if the program ends normally, and undefined otherwise.
  */
 
 int main(int argc, const char *argv[])
 {
-  imdb db(determinePathToData(argv[1])); // inlined in imdb-utils.h
+  const char *directory = NULL;
+  unsigned int threads = 1;
+  const char *pairsFileName = NULL;
+  const char *outputFileName = NULL;
+  const char *degreesSource = NULL;
+  bool estimate = false;
+  for (int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      if (!pathfinder::parseThreads(argv[++i], threads)) {
+        cerr << "--threads needs a positive number, not \"" << argv[i] << "\"." << endl;
+        return 1;
+      }
+    } else if (arg == "--batch" && i + 1 < argc) {
+      pairsFileName = argv[++i];
+    } else if (arg == "--degrees" && i + 1 < argc) {
+      degreesSource = argv[++i];
+    } else if (arg == "--estimate") {
+      estimate = true;
+    } else if (arg == "--output" && i + 1 < argc) {
+      outputFileName = argv[++i];
+    } else if (directory == NULL && arg.compare(0, 2, "--") != 0) {
+      directory = argv[i];
+    } else {
+      cerr << "Usage: six-degrees [--threads N] [--estimate] [data directory]" << endl
+           << "       six-degrees --batch <pairs file> [--output <results file>] [--threads N] [data directory]" << endl
+           << "       six-degrees --degrees <name> [--output <results file>] [--threads N] [data directory]" << endl;
+      return 1;
+    }
+  }
+
+  if (estimate && (pairsFileName != NULL || degreesSource != NULL)) {
+    cerr << "--estimate only applies to interactive searches, not to --batch or --degrees." << endl;
+    return 1;
+  }
+
+  directory = determinePathToData(directory); // inlined in imdb-utils.h
+  imdb db(directory);
   if (!db.good()) {
     cout << "Failed to properly initialize the imdb database." << endl;
     cout << "Please check to make sure the source files exist and that you have permission to read them." << endl;
     exit(1);
   }
+  landmarks oracle(db, directory);
+  if (estimate && !oracle.good()) {
+    cerr << "There are no up-to-date landmarks in \"" << directory << "\"; run imdb-build to make them." << endl;
+    return 1;
+  }
   
+  if (degreesSource != NULL) return runDegreeMap(db, degreesSource, outputFileName, threads);
+  if (pairsFileName != NULL) return runBatch(db, oracle.good() ? &oracle : NULL, pairsFileName, outputFileName, threads);
+
+  pathfinder finder(db, threads, oracle.good() ? &oracle : NULL);
   while (true) {
     string source = promptForActor("Actor or actress", db);
     if (source == "") break;
@@ -122,8 +376,10 @@ int main(int argc, const char *argv[])
     if (target == "") break;
     if (source == target) {
       cout << "Good one.  This is only interesting if you specify two different people." << endl;
+    } else if (estimate) {
+      printEstimate(source, target, db, oracle);
     } else {
-      generateShortestPath(source, target, db);
+      generateShortestPath(source, target, finder);
     }
   }
   